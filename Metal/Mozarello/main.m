@@ -63,6 +63,8 @@
         case kVK_DownArrow:  input->keys[K_Down] =   true; break;
         case kVK_LeftArrow:  input->keys[K_Left] =   true; break;
         case kVK_RightArrow: input->keys[K_Right] =  true; break;
+        case kVK_F1:         input->keys[K_F1] =     true; break;
+        case kVK_F2:         input->keys[K_F2] =     true; break;
     }
 }
 
@@ -73,6 +75,8 @@
         case kVK_DownArrow:  input->keys[K_Down] =   false; break;
         case kVK_LeftArrow:  input->keys[K_Left] =   false; break;
         case kVK_RightArrow: input->keys[K_Right] =  false; break;
+        case kVK_F1:         input->keys[K_F1] =     false; break;
+        case kVK_F2:         input->keys[K_F2] =     false; break;
     }
 }
 
@@ -154,9 +158,10 @@
     u64 _refreshRate;
 }
 
+// Reserves address space only, arenas commit it as they grow
 void *mapMemory(void *start, u64 size) {
-    void *mem = mmap(start, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-    if (mem == (void *)-1) {
+    void *mem = VMReserve(start, size, 0);
+    if (!mem) {
         NSLog(@"Failed to allocate memory!");
         [[NSApplication sharedApplication] terminate:NULL];
     }
@@ -249,15 +254,18 @@ void *mapMemory(void *start, u64 size) {
     _view.memory = _memory;
 
     void *memStart = (void *)TB(1);
-    void *mem = mapMemory(memStart, MB(10));
+    void *mem = mapMemory(memStart, MEMORY_RESERVE);
 
     _vertBuffer = [_device newBufferWithLength:MAX_VERTS * sizeof(struct Vert) options:MTLResourceStorageModeShared];
     _texturedVertBuffer = [_device newBufferWithLength:MAX_VERTS * sizeof(struct TexturedVert) options:MTLResourceStorageModeShared];
 
-    _memory->buffer = mem;
+    if (!MemoryInit(_memory, mem, MEMORY_RESERVE)) {
+        NSLog(@"Failed to commit memory!");
+        [[NSApplication sharedApplication] terminate:NULL];
+    }
 
     const unsigned char *fontData = [[self loadFontWithName:@"SF-Pro-Text-Regular" andType:@"otf"] bytes];
-    unsigned char *fontBitmap = malloc(1024*1024);
+    unsigned char *fontBitmap = Alloc(_memory->glyphs, 1024*1024);
 
     stbtt_pack_context context;
     stbtt_PackBegin(&context, fontBitmap, 1024, 1024, 0, 1, NULL);
@@ -277,7 +285,7 @@ void *mapMemory(void *start, u64 size) {
         {1024, 1024, 1}
     };
     [_fontTexture replaceRegion:region mipmapLevel:0 withBytes:fontBitmap bytesPerRow:1024*1];
-    free(fontBitmap);
+    Free(_memory->glyphs, fontBitmap);
 
     usTimerInit(&_timer);
     _lastTick = _startup = GetTimeus(&_timer);
@@ -294,8 +302,8 @@ void *mapMemory(void *start, u64 size) {
     _time->global = (f64)(now - _startup) / 1000000.0;
 
     struct RenderCommands renderCommands = RenderCommandsInit(
-        MB(1),
-        _memory->buffer,
+        (u32)_memory->commands.cap,
+        _memory->commands.base,
         MAX_VERTS,
         _vertBuffer.contents,
         MAX_VERTS,
@@ -314,6 +322,7 @@ void *mapMemory(void *start, u64 size) {
         &_textChars[0]
     };
 
+    renderCommands.commandArena = &_memory->commands;
     renderCommands.settings.headerFont = &headerFont;
     renderCommands.settings.textFont = &textFont;
 
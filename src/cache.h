@@ -0,0 +1,191 @@
+// On-disk cache of a JSON response together with its packed token tape.
+//
+// The file is a header followed by the raw JSON and the tape entries, each
+// section 8 byte aligned:
+//
+//     [TapeCacheHeader][json bytes, '\0'][jsmntape_t entries][jsmntape_wide_t]
+//
+// Loading maps the file read-only and points a jsmn_tape at the sections
+// inside the mapping, so reopening a cached response costs a checksum at
+// most and never runs the tokenizer. Files are written to a temporary name
+// and renamed into place, so readers only ever see a complete cache.
+//
+// Load failures: -1 can't open or map the file, -2 bad magic or version,
+// -3 the sizes don't add up or the tape doesn't fit the JSON, -4 checksum
+// mismatch.
+//
+// FileWriteAtomic and FileMap are shared with the other on-disk formats.
+//
+// Requires common.h and json.h. POSIX only for now.
+
+#include <sys/stat.h>
+
+#define TAPE_CACHE_MAGIC 0x4354544Du // "MTTC"
+#define TAPE_CACHE_VERSION 2
+
+struct TapeCacheHeader {
+    u32 magic;
+    u32 version;
+    u64 checksum; // HashBytes of everything after the header
+    u64 jsonLen;
+    u32 entryCount;
+    u32 wideCount;
+    u64 jsonOffset;
+    u64 entriesOffset;
+    u64 wideOffset;
+    u64 fileSize;
+};
+
+struct TapeCache {
+    void *base;
+    u64 size;
+    const char *json;
+    u64 jsonLen;
+    jsmn_tape tape; // points into the mapping, don't jsmn_tape_free it
+};
+
+// Writes `size` bytes to a temporary file next to `path` and renames it into
+// place once it's on disk. Returns 0 on success.
+int FileWriteAtomic(const char *path, const void *data, u64 size) {
+    char tempPath[1024];
+    snprintf(tempPath, sizeof(tempPath), "%s.%d.tmp", path, (int)getpid());
+
+    int fd = open(tempPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return -1;
+
+    u64 written = 0;
+    while (written < size) {
+        ssize_t n = write(fd, (const u8 *)data + written, size - written);
+        if (n <= 0)
+            break;
+        written += (u64)n;
+    }
+
+    int result = written == size && fsync(fd) == 0 ? 0 : -1;
+    close(fd);
+
+    if (result == 0 && rename(tempPath, path) != 0)
+        result = -1;
+    if (result != 0)
+        unlink(tempPath);
+    return result;
+}
+
+// Maps a whole file read-only. Returns NULL if it can't be opened, is
+// shorter than `minSize` or can't be mapped.
+void *FileMap(const char *path, u64 minSize, u64 *sizeOut) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (u64)st.st_size < minSize || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return NULL;
+
+    *sizeOut = (u64)st.st_size;
+    return base;
+}
+
+INLINE u64 TapeCacheAlign(u64 offset) {
+    return (offset + 7) & ~7ull;
+}
+
+INLINE void TapeCacheLayout(struct TapeCacheHeader *header, u64 jsonLen, u32 entryCount, u32 wideCount) {
+    memset(header, 0, sizeof(*header));
+    header->magic = TAPE_CACHE_MAGIC;
+    header->version = TAPE_CACHE_VERSION;
+    header->jsonLen = jsonLen;
+    header->entryCount = entryCount;
+    header->wideCount = wideCount;
+    header->jsonOffset = TapeCacheAlign(sizeof(struct TapeCacheHeader));
+    header->entriesOffset = TapeCacheAlign(header->jsonOffset + jsonLen + 1);
+    header->wideOffset = TapeCacheAlign(header->entriesOffset + (u64)entryCount * sizeof(jsmntape_t));
+    header->fileSize = header->wideOffset + (u64)wideCount * sizeof(jsmntape_wide_t);
+}
+
+// Writes `json` and its tape to `path`. Returns 0 on success.
+int TapeCacheWrite(const char *path, const char *json, u64 jsonLen, const jsmn_tape *tape) {
+    struct TapeCacheHeader header;
+    TapeCacheLayout(&header, jsonLen, tape->count, tape->wide_count);
+
+    u8 *image = calloc(1, header.fileSize);
+    if (!image)
+        return -1;
+
+    memcpy(image + header.jsonOffset, json, jsonLen);
+    memcpy(image + header.entriesOffset, tape->entries, (u64)tape->count * sizeof(jsmntape_t));
+    if (tape->wide_count)
+        memcpy(image + header.wideOffset, tape->wide, (u64)tape->wide_count * sizeof(jsmntape_wide_t));
+
+    header.checksum = HashBytes(image + sizeof(header), header.fileSize - sizeof(header), TAPE_CACHE_MAGIC);
+    memcpy(image, &header, sizeof(header));
+
+    int result = FileWriteAtomic(path, image, header.fileSize);
+    free(image);
+    return result;
+}
+
+// Maps a cache written by TapeCacheWrite. The tape is always checked with
+// jsmn_tape_check, which reads the entries once, so nothing read through it
+// lands outside the mapping. `verify` also checks the checksum, which
+// touches every page of the file.
+int TapeCacheOpen(const char *path, b32 verify, struct TapeCache *cache) {
+    memset(cache, 0, sizeof(*cache));
+
+    u64 size;
+    void *base = FileMap(path, sizeof(struct TapeCacheHeader), &size);
+    if (!base)
+        return -1;
+
+    const struct TapeCacheHeader *header = base;
+    struct TapeCacheHeader expected;
+    int result = 0;
+
+    if (header->magic != TAPE_CACHE_MAGIC || header->version != TAPE_CACHE_VERSION) {
+        result = -2;
+    } else {
+        TapeCacheLayout(&expected, header->jsonLen, header->entryCount, header->wideCount);
+        if (expected.fileSize != size || header->fileSize != size || expected.jsonOffset != header->jsonOffset ||
+                expected.entriesOffset != header->entriesOffset || expected.wideOffset != header->wideOffset)
+            result = -3;
+        else if (verify && HashBytes((u8 *)base + sizeof(*header), size - sizeof(*header), TAPE_CACHE_MAGIC) != header->checksum)
+            result = -4;
+    }
+
+    jsmn_tape tape = {0};
+    if (result == 0) {
+        tape.entries = (jsmntape_t *)((u8 *)base + header->entriesOffset);
+        tape.count = header->entryCount;
+        tape.wide = header->wideCount ? (jsmntape_wide_t *)((u8 *)base + header->wideOffset) : NULL;
+        tape.wide_count = header->wideCount;
+        tape.wide_cap = header->wideCount;
+        if (jsmn_tape_check(&tape, header->jsonLen) < 0)
+            result = -3;
+    }
+
+    if (result < 0) {
+        munmap(base, size);
+        return result;
+    }
+
+    cache->base = base;
+    cache->size = size;
+    cache->json = (const char *)base + header->jsonOffset;
+    cache->jsonLen = header->jsonLen;
+    cache->tape = tape;
+    return 0;
+}
+
+void TapeCacheClose(struct TapeCache *cache) {
+    if (cache->base)
+        munmap(cache->base, cache->size);
+    memset(cache, 0, sizeof(*cache));
+}
@@ -93,6 +93,7 @@ extern "C" {
 #endif
 
 #define ArrayCount(Array) (sizeof(Array) / sizeof((Array)[0]))
+#define INLINE static inline
 #define KB(x) (  (x)*1024LL)
 #define MB(x) (KB(x)*1024LL)
 #define GB(x) (MB(x)*1024LL)
@@ -171,6 +172,7 @@ struct Allocator {
 
 ALLOC_FUNC(defaultHeapAllocFunc);
 ALLOC_FUNC(arenaAllocFunc);
+ALLOC_FUNC(poolAllocFunc);
 
 struct Allocator DefaultHeapAllocator() {
     struct Allocator a = {
@@ -218,19 +220,1111 @@ void *Resize(struct Allocator a, void *ptr, u64 oldSize, u64 size) {
     return a.func(a.userdata, AT_Resize, size, oldSize, ptr);
 }
 
+// Virtual memory. Reserving only takes address space, nothing is usable
+// (or counted against the system) until it's committed.
+//
+// VM_HUGE_PAGES asks for transparent huge pages on Linux, which needs the
+// range 2MB aligned to do anything. Explicit hugetlbfs pages need a pool
+// set aside by the admin and can't be reserved without being committed, so
+// they aren't used. Elsewhere the flag is ignored.
+#define VM_HUGE_PAGES 0x1
+#define VM_HUGE_PAGE_SIZE MB(2)
+#define VM_COMMIT_STEP KB(64) // commits are rounded up to this
+#define VM_GUARD_SIZE  KB(64) // left uncommitted at the end of reserved arenas
+
+INLINE u64 VMAlignUp(u64 size, u64 align) {
+    return (size + (align - 1)) & ~(align - 1);
+}
+
+#if defined(PLATFORM_POSIX)
+// Asks for huge pages on an already reserved range
+void VMHugePages(void *ptr, u64 size) {
+#if defined(PLATFORM_LINUX) && defined(MADV_HUGEPAGE)
+    madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+}
+
+// Returns NULL on failure. `at` is a hint, like mmap's.
+void *VMReserve(void *at, u64 size, u32 flags) {
+    int mapFlags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+    mapFlags |= MAP_NORESERVE;
+#endif
+
+    // Huge pages only back 2MB aligned ranges, so take extra and trim
+    u64 slack = flags & VM_HUGE_PAGES ? VM_HUGE_PAGE_SIZE : 0;
+
+    u8 *base = mmap(at, size + slack, PROT_NONE, mapFlags, -1, 0);
+    if (base == MAP_FAILED)
+        return NULL;
+
+    if (slack) {
+        u8 *aligned = (u8 *)VMAlignUp((u64)(uintptr_t)base, VM_HUGE_PAGE_SIZE);
+        if (aligned > base)
+            munmap(base, aligned - base);
+        if (aligned + size < base + size + slack)
+            munmap(aligned + size, base + size + slack - (aligned + size));
+        base = aligned;
+    }
+
+    if (flags & VM_HUGE_PAGES)
+        VMHugePages(base, size);
+    return base;
+}
+
+b32 VMCommit(void *ptr, u64 size) {
+    return mprotect(ptr, size, PROT_READ | PROT_WRITE) == 0;
+}
+
+// Gives the pages back but keeps the range reserved
+void VMDecommit(void *ptr, u64 size) {
+    madvise(ptr, size, MADV_DONTNEED);
+    mprotect(ptr, size, PROT_NONE);
+}
+
+void VMRelease(void *ptr, u64 size) {
+    munmap(ptr, size);
+}
+#elif defined(PLATFORM_WINDOWS)
+void VMHugePages(void *ptr, u64 size) {}
+
+void *VMReserve(void *at, u64 size, u32 flags) {
+    void *base = VirtualAlloc(at, size, MEM_RESERVE, PAGE_NOACCESS);
+    if (!base && at)
+        base = VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+    return base;
+}
+
+b32 VMCommit(void *ptr, u64 size) {
+    return VirtualAlloc(ptr, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+}
+
+void VMDecommit(void *ptr, u64 size) {
+    VirtualFree(ptr, size, MEM_DECOMMIT);
+}
+
+void VMRelease(void *ptr, u64 size) {
+    VirtualFree(ptr, 0, MEM_RELEASE);
+}
+#endif
+
+// Bump allocator over a block of memory. Free is a no-op apart from giving
+// back the most recent allocation, FreeAll drops everything at once and
+// Resize grows the most recent allocation in place. Allocations are
+// ARENA_ALIGN aligned through the Allocator interface, ArenaPush takes any
+// power of two. Running out returns NULL.
+//
+// The block is either a fixed buffer (ArenaInit) or a reserved range
+// (ArenaInitReserved) that's committed as the bump pointer gets to it, so
+// it only takes the memory it has actually used. The last VM_GUARD_SIZE
+// bytes of a reserved range are never committed and fault on overrun.
+//
+// Temporary scopes save the bump pointer and put it back, so nested
+// per-frame or per-request scratch needs no frees:
+//
+//     struct ArenaTemp temp = ArenaTempBegin(&memory->scratch);
+//     ... allocate through ArenaAllocator(&memory->scratch) ...
+//     ArenaTempEnd(temp);
+#define ARENA_ALIGN 16
+#define ARENA_RESERVED 0x80000000u // set by ArenaInitReserved, shares flags with VM_HUGE_PAGES
+
+struct Arena {
+    u8 *base;
+    u64 used, cap; // cap is what's committed
+    u64 reserved;  // cap can grow up to this
+    u64 peak;
+    u64 last; // offset of the most recent allocation
+    u32 flags;
+};
+
+struct ArenaTemp {
+    struct Arena *arena;
+    u64 used, last;
+};
+
+void ArenaInit(struct Arena *arena, void *buffer, u64 size) {
+    arena->base = buffer;
+    arena->used = 0;
+    arena->cap = size;
+    arena->reserved = size;
+    arena->peak = 0;
+    arena->last = 0;
+    arena->flags = 0;
+}
+
+// `reserved` comes from VMReserve, or a page aligned slice of it, and
+// nothing in it is committed yet
+void ArenaInitReserved(struct Arena *arena, void *reserved, u64 size, u32 flags) {
+    ArenaInit(arena, reserved, 0);
+    arena->reserved = size > VM_GUARD_SIZE ? size - VM_GUARD_SIZE : 0;
+    arena->flags = flags | ARENA_RESERVED;
+    if (flags & VM_HUGE_PAGES)
+        VMHugePages(reserved, size);
+}
+
+// Makes sure the first `size` bytes are committed
+b32 ArenaCommit(struct Arena *arena, u64 size) {
+    if (size <= arena->cap)
+        return true;
+    if (size > arena->reserved)
+        return false;
+
+    u64 step = arena->flags & VM_HUGE_PAGES ? VM_HUGE_PAGE_SIZE : VM_COMMIT_STEP;
+    u64 cap = VMAlignUp(size, step);
+    if (cap > arena->reserved)
+        cap = arena->reserved;
+
+    if (!VMCommit(arena->base + arena->cap, cap - arena->cap))
+        return false;
+    arena->cap = cap;
+    return true;
+}
+
+// Gives back committed pages past the bump pointer, e.g. after a spike
+void ArenaDecommit(struct Arena *arena) {
+    if (!(arena->flags & ARENA_RESERVED))
+        return;
+
+    u64 keep = VMAlignUp(arena->used, VM_COMMIT_STEP);
+    if (keep < arena->cap) {
+        VMDecommit(arena->base + keep, arena->cap - keep);
+        arena->cap = keep;
+    }
+}
+
+void *ArenaPush(struct Arena *arena, u64 size, u64 align) {
+    // Align the address rather than the offset, the base may be less aligned
+    u64 base = (u64)(uintptr_t)arena->base;
+    u64 start = ((base + arena->used + (align - 1)) & ~(align - 1)) - base;
+    if (start + size < start)
+        return NULL;
+    if (start + size > arena->cap && !ArenaCommit(arena, start + size))
+        return NULL;
+
+    arena->last = start;
+    arena->used = start + size;
+    if (arena->used > arena->peak)
+        arena->peak = arena->used;
+    return arena->base + start;
+}
+
+INLINE void ArenaReset(struct Arena *arena) {
+    arena->used = 0;
+    arena->last = 0;
+}
+
+INLINE struct ArenaTemp ArenaTempBegin(struct Arena *arena) {
+    struct ArenaTemp temp = { arena, arena->used, arena->last };
+    return temp;
+}
+
+INLINE void ArenaTempEnd(struct ArenaTemp temp) {
+    ASSERT(temp.arena->used >= temp.used);
+    temp.arena->used = temp.used;
+    temp.arena->last = temp.last;
+}
+
+ALLOC_FUNC(arenaAllocFunc) {
+    struct Arena *arena = payload;
+
+    switch (type) {
+    case AT_Alloc: {
+        return ArenaPush(arena, size, ARENA_ALIGN);
+    } break;
+
+    case AT_Free: {
+        // Only the top allocation can be given back
+        if ((u8 *)old == arena->base + arena->last && arena->last < arena->used)
+            arena->used = arena->last;
+    } break;
+
+    case AT_FreeAll: {
+        ArenaReset(arena);
+    } break;
+
+    case AT_Resize: {
+        if (!old)
+            return ArenaPush(arena, size, ARENA_ALIGN);
+
+        u64 offset = (u8 *)old - arena->base;
+        if (offset == arena->last && ArenaCommit(arena, offset + size)) {
+            arena->used = offset + size;
+            if (arena->used > arena->peak)
+                arena->peak = arena->used;
+            return old;
+        }
+
+        void *moved = ArenaPush(arena, size, ARENA_ALIGN);
+        if (moved)
+            memcpy(moved, old, oldSize < size ? oldSize : size);
+        return moved;
+    } break;
+    }
+
+    return NULL;
+}
+
+struct Allocator ArenaAllocator(struct Arena *arena) {
+    struct Allocator a = {
+        arenaAllocFunc,
+        arena
+    };
+    return a;
+}
+
+// Pool allocator for small objects that come and go all the time, like
+// cards, labels and checklist items. Sizes are rounded up to one of
+// POOL_CLASS_COUNT power of two classes and every class is served from
+// POOL_SLAB_SIZE slabs with an intrusive free list, so Alloc and Free are
+// O(1) and never lock or touch the heap. Slabs are aligned to their size,
+// which lets Free find an object's slab by masking the pointer.
+//
+// Slabs come from a SlabCache over a fixed block of memory that any number
+// of pools can share. FreeAll hands every slab of a pool back to the cache
+// at once, so giving each open board its own pool makes closing it a
+// single call:
+//
+//     struct Pool pool;
+//     PoolInit(&pool, &memory->slabs, DefaultHeapAllocator());
+//     struct Allocator a = PoolAllocator(&pool);
+//     ...
+//     FreeAll(a);
+//
+// Anything bigger than POOL_MAX_SIZE, or anything once the cache has run
+// out of slabs, goes to the fallback allocator and has to be freed on its
+// own. A pool isn't thread safe, use one per thread.
+#define POOL_SLAB_SIZE   KB(64)
+#define POOL_MIN_SHIFT   4
+#define POOL_CLASS_COUNT 8
+#define POOL_MAX_SIZE    (1u << (POOL_MIN_SHIFT + POOL_CLASS_COUNT - 1))
+
+struct PoolFree {
+    struct PoolFree *next;
+};
+
+struct PoolSlab {
+    struct PoolSlab *next, *prev;
+    struct Pool *owner;
+    struct PoolFree *free;
+    u32 objectSize;
+    u32 capacity;
+    u32 used;
+    u32 bump; // objects from here on were never handed out
+#ifdef DIAGNOSTICS
+    u32 peak;
+    u64 allocs, frees;
+#endif
+};
+
+#define POOL_SLAB_HEADER ((sizeof(struct PoolSlab) + (ARENA_ALIGN - 1)) & ~(u64)(ARENA_ALIGN - 1))
+
+struct SlabCache {
+    struct Arena arena; // fresh slabs
+    struct PoolSlab *free;
+    u32 slabCount, freeCount;
+};
+
+struct PoolClass {
+    struct PoolSlab *partial; // slabs with room, the head is allocated from
+    struct PoolSlab *full;
+};
+
+struct Pool {
+    struct SlabCache *cache;
+    struct Allocator fallback;
+    struct PoolClass classes[POOL_CLASS_COUNT];
+};
+
+void SlabCacheInit(struct SlabCache *cache, void *buffer, u64 size) {
+    ArenaInit(&cache->arena, buffer, size);
+    cache->free = NULL;
+    cache->slabCount = 0;
+    cache->freeCount = 0;
+}
+
+// Same over a reserved range, slabs are committed as they're first needed
+void SlabCacheInitReserved(struct SlabCache *cache, void *reserved, u64 size, u32 flags) {
+    SlabCacheInit(cache, reserved, 0);
+    ArenaInitReserved(&cache->arena, reserved, size, flags);
+}
+
+INLINE b32 SlabCacheOwns(struct SlabCache *cache, void *ptr) {
+    return (u8 *)ptr >= cache->arena.base && (u8 *)ptr < cache->arena.base + cache->arena.reserved;
+}
+
+struct PoolSlab *SlabCacheGet(struct SlabCache *cache) {
+    struct PoolSlab *slab = cache->free;
+    if (slab) {
+        cache->free = slab->next;
+        cache->freeCount -= 1;
+        return slab;
+    }
+
+    slab = ArenaPush(&cache->arena, POOL_SLAB_SIZE, POOL_SLAB_SIZE);
+    if (slab)
+        cache->slabCount += 1;
+    return slab;
+}
+
+INLINE void SlabCachePut(struct SlabCache *cache, struct PoolSlab *slab) {
+    slab->next = cache->free;
+    cache->free = slab;
+    cache->freeCount += 1;
+}
+
+void PoolInit(struct Pool *pool, struct SlabCache *cache, struct Allocator fallback) {
+    memset(pool, 0, sizeof(*pool));
+    pool->cache = cache;
+    pool->fallback = fallback;
+}
+
+INLINE u32 PoolClassOf(u64 size) {
+    if (size <= (1u << POOL_MIN_SHIFT))
+        return 0;
+    return 64 - __builtin_clzll(size - 1) - POOL_MIN_SHIFT;
+}
+
+INLINE struct PoolSlab *PoolSlabOf(void *ptr) {
+    return (struct PoolSlab *)((uintptr_t)ptr & ~(uintptr_t)(POOL_SLAB_SIZE - 1));
+}
+
+INLINE void PoolUnlink(struct PoolSlab **list, struct PoolSlab *slab) {
+    if (slab->prev)
+        slab->prev->next = slab->next;
+    else
+        *list = slab->next;
+    if (slab->next)
+        slab->next->prev = slab->prev;
+}
+
+INLINE void PoolLink(struct PoolSlab **list, struct PoolSlab *slab) {
+    slab->prev = NULL;
+    slab->next = *list;
+    if (*list)
+        (*list)->prev = slab;
+    *list = slab;
+}
+
+void *PoolAlloc(struct Pool *pool, u64 size) {
+    if (size > POOL_MAX_SIZE)
+        return Alloc(pool->fallback, size);
+
+    u32 index = PoolClassOf(size);
+    struct PoolClass *sizeClass = &pool->classes[index];
+    struct PoolSlab *slab = sizeClass->partial;
+
+    if (!slab) {
+        slab = SlabCacheGet(pool->cache);
+        if (!slab)
+            return Alloc(pool->fallback, size);
+
+        memset(slab, 0, sizeof(*slab));
+        slab->owner = pool;
+        slab->objectSize = 1u << (index + POOL_MIN_SHIFT);
+        slab->capacity = (u32)((POOL_SLAB_SIZE - POOL_SLAB_HEADER) / slab->objectSize);
+        PoolLink(&sizeClass->partial, slab);
+    }
+
+    void *object;
+    if (slab->free) {
+        object = slab->free;
+        slab->free = slab->free->next;
+    } else {
+        object = (u8 *)slab + POOL_SLAB_HEADER + (u64)slab->bump * slab->objectSize;
+        slab->bump += 1;
+    }
+
+    slab->used += 1;
+#ifdef DIAGNOSTICS
+    slab->allocs += 1;
+    if (slab->used > slab->peak)
+        slab->peak = slab->used;
+#endif
+
+    if (slab->used == slab->capacity) {
+        PoolUnlink(&sizeClass->partial, slab);
+        PoolLink(&sizeClass->full, slab);
+    }
+
+    return object;
+}
+
+void PoolFree(struct Pool *pool, void *ptr) {
+    if (!SlabCacheOwns(pool->cache, ptr)) {
+        Free(pool->fallback, ptr);
+        return;
+    }
+
+    struct PoolSlab *slab = PoolSlabOf(ptr);
+    ASSERT_MSG(slab->owner == pool, "object freed to the wrong pool");
+    struct PoolClass *sizeClass = &pool->classes[PoolClassOf(slab->objectSize)];
+
+    struct PoolFree *node = ptr;
+    node->next = slab->free;
+    slab->free = node;
+
+#ifdef DIAGNOSTICS
+    slab->frees += 1;
+#endif
+
+    if (slab->used == slab->capacity) {
+        PoolUnlink(&sizeClass->full, slab);
+        PoolLink(&sizeClass->partial, slab);
+    }
+
+    slab->used -= 1;
+
+    // Keep one empty slab per class around so a single object going back
+    // and forth doesn't bounce a slab through the cache
+    if (slab->used == 0 && (slab->prev || slab->next)) {
+        PoolUnlink(&sizeClass->partial, slab);
+        SlabCachePut(pool->cache, slab);
+    }
+}
+
+// Gives every slab back to the cache. Fallback allocations aren't tracked.
+void PoolReset(struct Pool *pool) {
+    for (u32 i = 0; i < POOL_CLASS_COUNT; i += 1) {
+        struct PoolClass *sizeClass = &pool->classes[i];
+        struct PoolSlab *lists[2] = { sizeClass->partial, sizeClass->full };
+        for (u32 l = 0; l < 2; l += 1) {
+            struct PoolSlab *slab = lists[l];
+            while (slab) {
+                struct PoolSlab *next = slab->next;
+                SlabCachePut(pool->cache, slab);
+                slab = next;
+            }
+        }
+        sizeClass->partial = NULL;
+        sizeClass->full = NULL;
+    }
+}
+
+ALLOC_FUNC(poolAllocFunc) {
+    struct Pool *pool = payload;
+
+    switch (type) {
+    case AT_Alloc: {
+        return PoolAlloc(pool, size);
+    } break;
+
+    case AT_Free: {
+        PoolFree(pool, old);
+    } break;
+
+    case AT_FreeAll: {
+        PoolReset(pool);
+    } break;
+
+    case AT_Resize: {
+        if (!old)
+            return PoolAlloc(pool, size);
+
+        if (SlabCacheOwns(pool->cache, old)) {
+            if (size <= POOL_MAX_SIZE && PoolClassOf(size) == PoolClassOf(PoolSlabOf(old)->objectSize))
+                return old;
+        } else if (size > POOL_MAX_SIZE) {
+            return Resize(pool->fallback, old, oldSize, size);
+        }
+
+        void *moved = PoolAlloc(pool, size);
+        if (moved) {
+            memcpy(moved, old, oldSize < size ? oldSize : size);
+            PoolFree(pool, old);
+        }
+        return moved;
+    } break;
+    }
+
+    return NULL;
+}
+
+struct Allocator PoolAllocator(struct Pool *pool) {
+    struct Allocator a = {
+        poolAllocFunc,
+        pool
+    };
+    return a;
+}
+
+#ifdef DIAGNOSTICS
+// Prints every class in use and the occupancy of each of its slabs
+void PoolPrintStats(struct Pool *pool) {
+    for (u32 i = 0; i < POOL_CLASS_COUNT; i += 1) {
+        struct PoolClass *sizeClass = &pool->classes[i];
+        if (!sizeClass->partial && !sizeClass->full)
+            continue;
+
+        u32 slabs = 0, used = 0, capacity = 0;
+        u64 allocs = 0, frees = 0;
+        struct PoolSlab *lists[2] = { sizeClass->partial, sizeClass->full };
+        for (u32 l = 0; l < 2; l += 1) {
+            for (struct PoolSlab *slab = lists[l]; slab; slab = slab->next) {
+                slabs += 1;
+                used += slab->used;
+                capacity += slab->capacity;
+                allocs += slab->allocs;
+                frees += slab->frees;
+            }
+        }
+
+        printf("pool %5u bytes: %u slabs, %u/%u objects (%.1f%%), %llu allocs, %llu frees\n",
+            1u << (i + POOL_MIN_SHIFT), slabs, used, capacity, 100.0 * used / capacity,
+            (unsigned long long)allocs, (unsigned long long)frees);
+        for (u32 l = 0; l < 2; l += 1) {
+            for (struct PoolSlab *slab = lists[l]; slab; slab = slab->next)
+                printf("    slab %p: %u/%u (peak %u)\n", (void *)slab, slab->used, slab->capacity, slab->peak);
+        }
+    }
+}
+#endif
+
+#if defined(PLATFORM_POSIX)
+// Per-thread heaps for worker threads. The first allocation a thread makes
+// through ThreadAllocator() gives it its own ThreadHeap: a Pool over slabs
+// only that thread allocates from, plus a scratch Arena. Nothing on the
+// allocation path locks or shares cache lines with other threads.
+//
+// Every heap lives in one reserved range, THREAD_HEAP_SIZE apart, so any
+// pointer maps straight back to the heap that owns it. Freeing an object
+// that belongs to another thread pushes it onto that heap's remote list
+// with a compare and swap, and the owner takes the whole list back the next
+// time it allocates. ThreadAllocator() carries no state, the same value
+// works on every thread.
+//
+// When a thread exits its heap is kept as it is and given to the next new
+// thread, so objects it handed out stay valid and keep draining back.
+//
+// Whole results move between threads as arenas: a worker fills an arena
+// from ArenaCreate and HandoffPush'es it, the receiving thread
+// HandoffPop's it and eventually calls ArenaDestroy. Nothing is copied.
+#define THREAD_HEAP_MAX     64
+#define THREAD_HEAP_SIZE    GB(1)
+#define THREAD_SCRATCH_SIZE MB(256)
+
+struct ThreadHeap {
+    struct Pool pool;
+    struct SlabCache slabs;
+    struct Arena scratch;
+    u32 index;
+
+    // Written by other threads, kept off the owner's cache lines
+    struct PoolFree *remote __attribute__((aligned(64)));
+};
+
+struct ThreadHeaps {
+    pthread_mutex_t lock;
+    pthread_key_t key;
+    u8 *base;
+    u32 used;
+    u32 freeCount;
+    u32 free[THREAD_HEAP_MAX]; // heaps of threads that have exited
+    b8 ready[THREAD_HEAP_MAX]; // header committed and set up
+};
+
+static struct ThreadHeaps threadHeaps = { PTHREAD_MUTEX_INITIALIZER };
+static pthread_once_t threadHeapsOnce = PTHREAD_ONCE_INIT;
+static __thread struct ThreadHeap *threadHeap;
+
+void ThreadHeapRelease(void *payload) {
+    struct ThreadHeap *heap = payload;
+    pthread_mutex_lock(&threadHeaps.lock);
+    threadHeaps.free[threadHeaps.freeCount++] = heap->index;
+    pthread_mutex_unlock(&threadHeaps.lock);
+}
+
+void ThreadHeapsInit() {
+    // NOTE(Brett): only address space, heaps commit what they use
+    void *base = VMReserve(NULL, (u64)THREAD_HEAP_MAX * THREAD_HEAP_SIZE, 0);
+    if (!base)
+        return;
+
+    pthread_key_create(&threadHeaps.key, ThreadHeapRelease);
+    threadHeaps.base = base;
+}
+
+// The heap of the calling thread, set up on first use. NULL if there are
+// already THREAD_HEAP_MAX threads with one.
+struct ThreadHeap *ThreadHeapGet() {
+    if (threadHeap)
+        return threadHeap;
+
+    pthread_once(&threadHeapsOnce, ThreadHeapsInit);
+    if (!threadHeaps.base)
+        return NULL;
+
+    pthread_mutex_lock(&threadHeaps.lock);
+    u32 index = THREAD_HEAP_MAX;
+    if (threadHeaps.freeCount)
+        index = threadHeaps.free[--threadHeaps.freeCount];
+    else if (threadHeaps.used < THREAD_HEAP_MAX)
+        index = threadHeaps.used++;
+    pthread_mutex_unlock(&threadHeaps.lock);
+
+    if (index == THREAD_HEAP_MAX)
+        return NULL;
+
+    u8 *block = threadHeaps.base + (u64)index * THREAD_HEAP_SIZE;
+    struct ThreadHeap *heap = (struct ThreadHeap *)block;
+    if (!threadHeaps.ready[index]) {
+        // Header, slabs, then scratch at the end
+        u64 header = POOL_SLAB_SIZE;
+        if (!VMCommit(block, sizeof(struct ThreadHeap))) {
+            // Give the slot back, whoever gets it next tries the commit again
+            pthread_mutex_lock(&threadHeaps.lock);
+            threadHeaps.free[threadHeaps.freeCount++] = index;
+            pthread_mutex_unlock(&threadHeaps.lock);
+            return NULL;
+        }
+
+        SlabCacheInitReserved(&heap->slabs, block + header, THREAD_HEAP_SIZE - THREAD_SCRATCH_SIZE - header, 0);
+        PoolInit(&heap->pool, &heap->slabs, DefaultHeapAllocator());
+        ArenaInitReserved(&heap->scratch, block + THREAD_HEAP_SIZE - THREAD_SCRATCH_SIZE, THREAD_SCRATCH_SIZE, 0);
+        heap->index = index;
+        heap->remote = NULL;
+        threadHeaps.ready[index] = true;
+    }
+
+    ArenaReset(&heap->scratch);
+    pthread_setspecific(threadHeaps.key, heap);
+    threadHeap = heap;
+    return heap;
+}
+
+// The heap whose slabs `ptr` is in, or NULL
+INLINE struct ThreadHeap *ThreadHeapOf(void *ptr) {
+    u8 *base = threadHeaps.base;
+    if (!base || (u8 *)ptr < base || (u8 *)ptr >= base + (u64)THREAD_HEAP_MAX * THREAD_HEAP_SIZE)
+        return NULL;
+
+    struct ThreadHeap *heap = (struct ThreadHeap *)(base + ((u8 *)ptr - base) / THREAD_HEAP_SIZE * THREAD_HEAP_SIZE);
+    return SlabCacheOwns(&heap->slabs, ptr) ? heap : NULL;
+}
+
+INLINE void ThreadHeapFreeRemote(struct ThreadHeap *owner, void *ptr) {
+    struct PoolFree *node = ptr;
+    node->next = __atomic_load_n(&owner->remote, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&owner->remote, &node->next, node, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {}
+}
+
+// Takes back everything other threads freed. Only the owner calls this, and
+// it takes the whole list at once, so there's no ABA problem.
+INLINE void ThreadHeapDrain(struct ThreadHeap *heap) {
+    if (!__atomic_load_n(&heap->remote, __ATOMIC_RELAXED))
+        return;
+
+    struct PoolFree *node = __atomic_exchange_n(&heap->remote, NULL, __ATOMIC_ACQUIRE);
+    while (node) {
+        struct PoolFree *next = node->next;
+        PoolFree(&heap->pool, node);
+        node = next;
+    }
+}
+
+void *ThreadAlloc(u64 size) {
+    struct ThreadHeap *heap = ThreadHeapGet();
+    if (!heap)
+        return malloc(size);
+
+    ThreadHeapDrain(heap);
+    return PoolAlloc(&heap->pool, size);
+}
+
+void ThreadFree(void *ptr) {
+    struct ThreadHeap *owner = ThreadHeapOf(ptr);
+    if (!owner)
+        free(ptr); // too big for a pool or allocated without a heap
+    else if (owner == threadHeap)
+        PoolFree(&owner->pool, ptr);
+    else
+        ThreadHeapFreeRemote(owner, ptr);
+}
+
+ALLOC_FUNC(threadAllocFunc) {
+    switch (type) {
+    case AT_Alloc: {
+        return ThreadAlloc(size);
+    } break;
+
+    case AT_Free: {
+        ThreadFree(old);
+    } break;
+
+    case AT_FreeAll: {
+        // Objects may have been handed to other threads, free them one by one
+    } break;
+
+    case AT_Resize: {
+        if (!old)
+            return ThreadAlloc(size);
+
+        struct ThreadHeap *owner = ThreadHeapOf(old);
+        if (owner && owner == threadHeap)
+            return poolAllocFunc(&owner->pool, AT_Resize, size, oldSize, old);
+        if (!owner && size > POOL_MAX_SIZE)
+            return realloc(old, size);
+
+        void *moved = ThreadAlloc(size);
+        if (moved) {
+            memcpy(moved, old, oldSize < size ? oldSize : size);
+            ThreadFree(old);
+        }
+        return moved;
+    } break;
+    }
+
+    return NULL;
+}
+
+struct Allocator ThreadAllocator() {
+    struct Allocator a = {
+        threadAllocFunc,
+        0
+    };
+    return a;
+}
+
+// Scratch arena of the calling thread, reset whenever its owner likes
+struct Arena *ThreadScratch() {
+    struct ThreadHeap *heap = ThreadHeapGet();
+    return heap ? &heap->scratch : NULL;
+}
+
+// An arena in its own mapping, so it can outlive the thread that filled it
+struct ArenaBlock {
+    struct Arena arena;
+    struct ArenaBlock *next;
+    u64 mapped;
+};
+
+// The payload starts a commit step in so it stays page aligned
+#define ARENA_BLOCK_HEADER VM_COMMIT_STEP
+
+// Reserves `size` bytes, which are committed as the arena fills up
+struct Arena *ArenaCreate(u64 size) {
+    u64 mapped = ARENA_BLOCK_HEADER + size + VM_GUARD_SIZE;
+    void *base = VMReserve(NULL, mapped, 0);
+    if (!base)
+        return NULL;
+    if (!VMCommit(base, sizeof(struct ArenaBlock))) {
+        VMRelease(base, mapped);
+        return NULL;
+    }
+
+    struct ArenaBlock *block = base;
+    ArenaInitReserved(&block->arena, (u8 *)base + ARENA_BLOCK_HEADER, size + VM_GUARD_SIZE, 0);
+    block->next = NULL;
+    block->mapped = mapped;
+    return &block->arena;
+}
+
+void ArenaDestroy(struct Arena *arena) {
+    struct ArenaBlock *block = (struct ArenaBlock *)arena;
+    VMRelease(block, block->mapped);
+}
+
+// Arenas passed from any number of threads to one receiver, in the order
+// they were pushed. Zero is an empty queue.
+struct Handoff {
+    struct ArenaBlock *incoming; // pushed lock-free, newest first
+    struct ArenaBlock *pending;  // receiver only, oldest first
+};
+
+void HandoffPush(struct Handoff *queue, struct Arena *arena) {
+    struct ArenaBlock *block = (struct ArenaBlock *)arena;
+    block->next = __atomic_load_n(&queue->incoming, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&queue->incoming, &block->next, block, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {}
+}
+
+// Next arena for the receiving thread, or NULL if nothing has arrived
+struct Arena *HandoffPop(struct Handoff *queue) {
+    if (!queue->pending) {
+        struct ArenaBlock *block = __atomic_exchange_n(&queue->incoming, NULL, __ATOMIC_ACQUIRE);
+        while (block) {
+            struct ArenaBlock *next = block->next;
+            block->next = queue->pending;
+            queue->pending = block;
+            block = next;
+        }
+    }
+
+    struct ArenaBlock *block = queue->pending;
+    if (block)
+        queue->pending = block->next;
+    return block ? &block->arena : NULL;
+}
+#endif
+
+// Allocation telemetry. TrackAllocator wraps any allocator and counts what
+// goes through it under a tag like "json", "glyphs", "model" or "frame":
+// live and peak bytes, allocation and free counts, and a histogram of
+// allocation sizes. Every AllocStats registers itself on init, so the
+// overlay and AllocStatsDump see all of them without being told:
+//
+//     static struct AllocStats jsonStats;
+//     AllocStatsInit(&jsonStats, "json", DefaultHeapAllocator());
+//     struct Allocator json = TrackAllocator(&jsonStats);
+//
+// Each allocation carries a 16 byte header with its size, which is how
+// Free knows what to take off. Counters are atomic, so a tracked allocator
+// can be shared between threads if the one it wraps can.
+//
+// A header would push every pool object up a size class, so stats set up
+// with AllocStatsInitPool leave objects in slabs alone and count them at
+// their slab's object size, what they really take. Only what the pool
+// hands to its fallback gets a header.
+#define ALLOC_STATS_BUCKETS 16 // bucket i counts sizes up to 16 << i, the last one the rest
+#define ALLOC_STATS_HEADER  16
+
+struct AllocStats {
+    const char *tag;
+    struct Allocator inner;
+    u64 live, peak; // bytes
+    u64 allocs, frees, resizes;
+    u64 histogram[ALLOC_STATS_BUCKETS];
+    struct Pool *pool; // set by AllocStatsInitPool
+    struct AllocStats *next;
+};
+
+static struct AllocStats *allocStatsList;
+
+// Registers `stats`. Call it once per AllocStats, they're never removed.
+void AllocStatsInit(struct AllocStats *stats, const char *tag, struct Allocator inner) {
+    memset(stats, 0, sizeof(*stats));
+    stats->tag = tag;
+    stats->inner = inner;
+
+    stats->next = __atomic_load_n(&allocStatsList, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&allocStatsList, &stats->next, stats, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {}
+}
+
+void AllocStatsInitPool(struct AllocStats *stats, const char *tag, struct Pool *pool) {
+    AllocStatsInit(stats, tag, PoolAllocator(pool));
+    stats->pool = pool;
+}
+
+INLINE struct AllocStats *AllocStatsFirst() {
+    return __atomic_load_n(&allocStatsList, __ATOMIC_ACQUIRE);
+}
+
+INLINE u32 AllocStatsBucket(u64 size) {
+    if (size <= 16)
+        return 0;
+    u32 bucket = 64 - __builtin_clzll(size - 1) - 4;
+    return bucket < ALLOC_STATS_BUCKETS ? bucket : ALLOC_STATS_BUCKETS - 1;
+}
+
+INLINE void AllocStatsGrow(struct AllocStats *stats, u64 size) {
+    u64 live = __atomic_add_fetch(&stats->live, size, __ATOMIC_RELAXED);
+    u64 peak = __atomic_load_n(&stats->peak, __ATOMIC_RELAXED);
+    while (live > peak && !__atomic_compare_exchange_n(&stats->peak, &peak, live, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+}
+
+// Allocates `size` and sets *counted to the bytes to charge for it
+INLINE void *TrackPoolAlloc(struct AllocStats *stats, u64 size, u64 *counted) {
+    struct Pool *pool = stats->pool;
+    if (size <= POOL_MAX_SIZE) {
+        void *object = PoolAlloc(pool, size);
+        if (object && SlabCacheOwns(pool->cache, object)) {
+            *counted = PoolSlabOf(object)->objectSize;
+            return object;
+        }
+
+        // Out of slabs, redo it below with a header
+        if (object)
+            Free(pool->fallback, object);
+    }
+
+    u8 *block = Alloc(pool->fallback, size + ALLOC_STATS_HEADER);
+    if (!block)
+        return NULL;
+
+    *(u64 *)block = size;
+    *counted = size;
+    return block + ALLOC_STATS_HEADER;
+}
+
+// Frees `ptr` and returns what it was charged
+INLINE u64 TrackPoolFree(struct AllocStats *stats, void *ptr) {
+    struct Pool *pool = stats->pool;
+    if (SlabCacheOwns(pool->cache, ptr)) {
+        u64 size = PoolSlabOf(ptr)->objectSize;
+        PoolFree(pool, ptr);
+        return size;
+    }
+
+    u8 *block = (u8 *)ptr - ALLOC_STATS_HEADER;
+    u64 size = *(u64 *)block;
+    Free(pool->fallback, block);
+    return size;
+}
+
+ALLOC_FUNC(trackAllocFunc) {
+    struct AllocStats *stats = payload;
+
+    switch (type) {
+    case AT_Alloc: {
+        u64 counted = size;
+        u8 *object;
+        if (stats->pool) {
+            object = TrackPoolAlloc(stats, size, &counted);
+        } else {
+            u8 *block = Alloc(stats->inner, size + ALLOC_STATS_HEADER);
+            object = block ? block + ALLOC_STATS_HEADER : NULL;
+            if (block)
+                *(u64 *)block = size;
+        }
+        if (!object)
+            return NULL;
+
+        AllocStatsGrow(stats, counted);
+        __atomic_add_fetch(&stats->allocs, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&stats->histogram[AllocStatsBucket(size)], 1, __ATOMIC_RELAXED);
+        return object;
+    } break;
+
+    case AT_Free: {
+        u64 counted;
+        if (stats->pool) {
+            counted = TrackPoolFree(stats, old);
+        } else {
+            u8 *block = (u8 *)old - ALLOC_STATS_HEADER;
+            counted = *(u64 *)block;
+            Free(stats->inner, block);
+        }
+        __atomic_sub_fetch(&stats->live, counted, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&stats->frees, 1, __ATOMIC_RELAXED);
+    } break;
+
+    case AT_FreeAll: {
+        FreeAll(stats->inner);
+        __atomic_store_n(&stats->live, 0, __ATOMIC_RELAXED);
+    } break;
+
+    case AT_Resize: {
+        if (!old)
+            return trackAllocFunc(payload, AT_Alloc, size, 0, NULL);
+
+        if (stats->pool) {
+            __atomic_add_fetch(&stats->resizes, 1, __ATOMIC_RELAXED);
+            struct Pool *pool = stats->pool;
+            if (SlabCacheOwns(pool->cache, old) && size <= PoolSlabOf(old)->objectSize)
+                return old;
+
+            u64 counted;
+            void *moved = TrackPoolAlloc(stats, size, &counted);
+            if (!moved)
+                return NULL;
+
+            memcpy(moved, old, oldSize < size ? oldSize : size);
+            AllocStatsGrow(stats, counted);
+            __atomic_sub_fetch(&stats->live, TrackPoolFree(stats, old), __ATOMIC_RELAXED);
+            return moved;
+        }
+
+        u8 *block = (u8 *)old - ALLOC_STATS_HEADER;
+        u64 previous = *(u64 *)block;
+        block = Resize(stats->inner, block, previous + ALLOC_STATS_HEADER, size + ALLOC_STATS_HEADER);
+        if (!block)
+            return NULL;
+
+        *(u64 *)block = size;
+        if (size > previous)
+            AllocStatsGrow(stats, size - previous);
+        else
+            __atomic_sub_fetch(&stats->live, previous - size, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&stats->resizes, 1, __ATOMIC_RELAXED);
+        return block + ALLOC_STATS_HEADER;
+    } break;
+    }
+
+    return NULL;
+}
+
+struct Allocator TrackAllocator(struct AllocStats *stats) {
+    struct Allocator a = {
+        trackAllocFunc,
+        stats
+    };
+    return a;
+}
+
+// Writes every registered AllocStats to `out`
+void AllocStatsWrite(FILE *out) {
+    fprintf(out, "%-10s %12s %12s %10s %10s %10s\n", "tag", "live", "peak", "allocs", "frees", "resizes");
+    for (struct AllocStats *stats = AllocStatsFirst(); stats; stats = stats->next) {
+        fprintf(out, "%-10s %12llu %12llu %10llu %10llu %10llu\n", stats->tag,
+            (unsigned long long)stats->live, (unsigned long long)stats->peak,
+            (unsigned long long)stats->allocs, (unsigned long long)stats->frees,
+            (unsigned long long)stats->resizes);
+        if (!stats->allocs)
+            continue;
+
+        fprintf(out, "%10s", "");
+        for (u32 i = 0; i < ALLOC_STATS_BUCKETS; i += 1) {
+            if (stats->histogram[i])
+                fprintf(out, " %s%llu:%llu", i == ALLOC_STATS_BUCKETS - 1 ? ">" : "<=",
+                    (unsigned long long)(i == ALLOC_STATS_BUCKETS - 1 ? 16ull << (i - 1) : 16ull << i),
+                    (unsigned long long)stats->histogram[i]);
+        }
+        fprintf(out, "\n");
+    }
+}
+
+// Writes the same report to a file. Returns 0 on success.
+int AllocStatsDump(const char *path) {
+    FILE *out = fopen(path, "w");
+    if (!out)
+        return -1;
+
+    AllocStatsWrite(out);
+    return fclose(out) == 0 ? 0 : -1;
+}
+
+// Stretchy buffers. An Array(Type) is a plain Type * that can be indexed
+// as usual, with a header just before the first element holding the length,
+// the capacity and the allocator it grows through:
+//
+//     Array(struct Board) boards;
+//     ArrayInit(boards, allocator);
+//     ArrayPush(boards, board);
+//     for (u64 i = 0; i < ArrayLen(boards); i += 1)
+//         ...
+//     ArrayFree(boards);
+//
+// Growing doubles the capacity (ARRAY_GROW) through Resize, so pushes are
+// amortized O(1), and may move the elements, so don't hold on to pointers
+// into an array across a push.
+//
+// Short lists can start in a buffer on the stack or inside another struct
+// and only go to the allocator once they outgrow it:
+//
+//     ArraySmall(u32, 16) storage;
+//     Array(u32) rows;
+//     ArrayInitSmall(rows, storage, allocator);
+//
+// When a grow runs out of memory the array keeps its old block and sets
+// ARRAY_FAILED, pushes that don't fit are dropped, so check ArrayFailed
+// once the array is filled rather than after every push.
+#define ARRAY_INLINE 0x1 // elements are in an ArraySmall, never freed
+#define ARRAY_FAILED 0x2 // a grow ran out of memory, some pushes were dropped
+
 struct ArrayHeader {
     struct Allocator allocator;
     u64 len, cap;
-};
+    u32 flags;
+} __attribute__((aligned(16)));
 
 #define Array(Type) Type *
+#define ArraySmall(Type, n) struct { struct ArrayHeader header; Type items[n]; }
 
 #define ARRAY_GROW(x)     (2*(x) + 8)
-#define ARRAY_HEADER(x)   ((ArrayHeader *)(x) - 1)
+#define ARRAY_HEADER(x)   ((struct ArrayHeader *)(x) - 1)
 #define ArrayAllocator(x) (ARRAY_HEADER(x)->allocator)
 #define ArrayLen(x)       (ARRAY_HEADER(x)->len)
 #define ArrayCap(x)       (ARRAY_HEADER(x)->cap)
-#define INLINE static inline
+#define ArrayLast(x)      ((x)[ArrayLen(x) - 1])
+#define ArrayFailed(x)    (ARRAY_HEADER(x)->flags & ARRAY_FAILED)
 
 #define ArrayClear(x) do { ARRAY_HEADER(x)->len = 0; } while (0)
 #define ArrayPop(x)   do { ARRAY_HEADER(x)->len -= 1; } while(0)
@@ -241,40 +1335,283 @@ struct ArrayHeader {
     _ah->allocator = _allocator; \
     _ah->len = 0; \
     _ah->cap = _cap; \
+    _ah->flags = 0; \
     *_array = (void *)(_ah+1); \
 } while (0)
 
 #define ArrayInit(x, allocator) ArrayInitReserve(x, allocator, ARRAY_GROW(0))
 
+#define ArrayInitSmall(x, small, _allocator) do { \
+    (small).header.allocator = _allocator; \
+    (small).header.len = 0; \
+    (small).header.cap = ArrayCount((small).items); \
+    (small).header.flags = ARRAY_INLINE; \
+    (x) = (small).items; \
+} while (0)
+
+// Moves the elements to a block of at least `minCap` from the array's
+// allocator and returns the new first element. Out of memory it returns
+// `array` as it was with ARRAY_FAILED set.
+void *ArrayGrowTo(void *array, u64 elemSize, u64 minCap) {
+    struct ArrayHeader *header = ARRAY_HEADER(array);
+    u64 cap = ARRAY_GROW(header->cap);
+    if (cap < minCap)
+        cap = minCap;
+
+    u64 oldSize = sizeof(struct ArrayHeader) + elemSize * header->cap;
+    u64 size = sizeof(struct ArrayHeader) + elemSize * cap;
+
+    struct ArrayHeader *grown;
+    if (header->flags & ARRAY_INLINE) {
+        grown = Alloc(header->allocator, size);
+        if (grown)
+            memcpy(grown, header, sizeof(struct ArrayHeader) + elemSize * header->len);
+    } else {
+        grown = Resize(header->allocator, header, oldSize, size);
+    }
+    if (!grown) {
+        header->flags |= ARRAY_FAILED;
+        return array;
+    }
+
+    grown->cap = cap;
+    grown->flags &= ~ARRAY_INLINE;
+    return grown + 1;
+}
+
+// Gives the unused capacity back, unless the elements are still inline
+void *ArrayShrinkTo(void *array, u64 elemSize) {
+    struct ArrayHeader *header = ARRAY_HEADER(array);
+    if (header->flags & ARRAY_INLINE || header->len == header->cap)
+        return array;
+
+    u64 oldSize = sizeof(struct ArrayHeader) + elemSize * header->cap;
+    u64 size = sizeof(struct ArrayHeader) + elemSize * header->len;
+    struct ArrayHeader *shrunk = Resize(header->allocator, header, oldSize, size);
+    if (!shrunk)
+        return array;
+
+    shrunk->cap = shrunk->len;
+    return shrunk + 1;
+}
+
+#define ArrayGrow(x, _minCap) do { \
+    void **_array = (void **)&(x); \
+    *_array = ArrayGrowTo((x), sizeof(*(x)), (_minCap)); \
+} while (0)
+
+#define ArrayReserve(x, n) do { \
+    if (ArrayCap(x) < (u64)(n)) \
+        ArrayGrow(x, (n)); \
+} while (0)
+
+#define ArrayFree(x) do { \
+    struct ArrayHeader *_ah = ARRAY_HEADER(x); \
+    if (!(_ah->flags & ARRAY_INLINE)) \
+        Free(_ah->allocator, _ah); \
+    (x) = NULL; \
+} while (0)
+
+#define ArrayShrink(x) do { \
+    void **_array = (void **)&(x); \
+    *_array = ArrayShrinkTo((x), sizeof(*(x))); \
+} while (0)
+
+#define ArrayPush(x, item) do { \
+    if (ArrayLen(x) == ArrayCap(x)) \
+        ArrayGrow(x, ArrayLen(x) + 1); \
+    if (ArrayLen(x) < ArrayCap(x)) \
+        (x)[ARRAY_HEADER(x)->len++] = (item); \
+} while (0)
+
+#define ArrayPushN(x, items, n) do { \
+    u64 _n = (n); \
+    ArrayReserve(x, ArrayLen(x) + _n); \
+    if (ArrayCap(x) - ArrayLen(x) >= _n) { \
+        memcpy((x) + ArrayLen(x), (items), sizeof(*(x)) * _n); \
+        ARRAY_HEADER(x)->len += _n; \
+    } \
+} while (0)
+
+#define ArrayInsert(x, index, item) do { \
+    u64 _index = (index); \
+    if (ArrayLen(x) == ArrayCap(x)) \
+        ArrayGrow(x, ArrayLen(x) + 1); \
+    if (ArrayLen(x) < ArrayCap(x)) { \
+        memmove((x) + _index + 1, (x) + _index, sizeof(*(x)) * (ArrayLen(x) - _index)); \
+        (x)[_index] = (item); \
+        ARRAY_HEADER(x)->len += 1; \
+    } \
+} while (0)
+
+// Moves the last element into `index`, O(1) but doesn't keep the order
+#define ArrayRemoveSwap(x, index) do { \
+    u64 _index = (index); \
+    ARRAY_HEADER(x)->len -= 1; \
+    (x)[_index] = (x)[ArrayLen(x)]; \
+} while (0)
+
 #define JOIN2(a, b) a##b
-#define TABLE(name, value) \
-    TABLE_DECLARE(name, value); \
-    TABLE_DEFINE(name, value);
 
-#define TABLE_DECLARE(name, value) \
+// Mixes a u64 key so that sequential or patterned keys spread over the
+// table (the murmur3 finalizer)
+INLINE u64 TableHash(u64 key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ull;
+    key ^= key >> 33;
+    return key;
+}
+
+#define TABLE_MIN_CAP 16
+#define TABLE_MAX_DIST 255
+
+// Open addressing map from u64 to `Value` with Robin Hood probing.
+//
+//     TABLE(CardRows, u32)
+//
+//     struct CardRows rows;
+//     CardRowsInit(&rows, allocator);
+//     CardRowsSet(&rows, key, row);
+//     u32 *row = CardRowsGet(&rows, key);
+//
+// Each slot keeps its key, value and its distance from its home slot plus
+// one (0 for empty, so every key including 0 is usable) together, so a
+// probe touches one cache line. Inserts take the slot of any entry closer
+// to home than themselves, which keeps probe lengths short and lets a
+// lookup stop as soon as it sees a closer entry. Removing shifts the rest
+// of the run back instead of leaving a tombstone. The capacity is a power
+// of two and doubles past 7/8 load.
+#define TABLE(name, Value) \
+    TABLE_DECLARE(name, Value) \
+    TABLE_DEFINE(name, Value)
+
+#define TABLE_DECLARE(name, Value) \
+    struct JOIN2(name, Slot) { \
+        u64 key; \
+        Value val; \
+        u8 dist; \
+    }; \
+\
     struct name { \
-        u64 *keys; \
-        value *values; \
+        struct JOIN2(name, Slot) *slots; \
         u64 len, cap; \
         struct Allocator allocator; \
-    } \
+    }; \
 \
-void   JOIN2(name, Init) (name *h, struct Allocator a); \
-value *JOIN2(name, Get)  (name *h, u64 key); \
-void   JOIN2(name, Set)  (name *h, u64 key, value val); \
-void   JOIN2(name, Grow) (name *h);
-
-#define TABLE_DEFINE(name, value) \
-void JOIN2(name, Init)(name *h, struct Allocator a) { \
-    h->keys = Alloc(a, sizeof(u64) * 100); \
-    h->values = Alloc(a, sizeof(value) * 100); \
+void   JOIN2(name, InitReserve) (struct name *h, struct Allocator a, u64 cap); \
+void   JOIN2(name, Init)   (struct name *h, struct Allocator a); \
+void   JOIN2(name, Free)   (struct name *h); \
+Value *JOIN2(name, Get)    (struct name *h, u64 key); \
+void   JOIN2(name, Set)    (struct name *h, u64 key, Value val); \
+b32    JOIN2(name, Remove) (struct name *h, u64 key); \
+void   JOIN2(name, Grow)   (struct name *h);
+
+#define TABLE_DEFINE(name, Value) \
+void JOIN2(name, InitReserve)(struct name *h, struct Allocator a, u64 cap) { \
+    u64 pow2 = TABLE_MIN_CAP; \
+    while (pow2 - pow2 / 8 < cap) pow2 *= 2; \
+    h->slots = Alloc(a, sizeof(struct JOIN2(name, Slot)) * pow2); \
+    for (u64 i = 0; i < pow2; i += 1) \
+        h->slots[i].dist = 0; \
     h->len = 0; \
-    h->cap = 100; \
+    h->cap = pow2; \
     h->allocator = a; \
 } \
 \
-value *JOIN2(name, Get)(name *h, u64 key) { \
-   \
+void JOIN2(name, Init)(struct name *h, struct Allocator a) { \
+    JOIN2(name, InitReserve)(h, a, 0); \
+} \
+\
+void JOIN2(name, Free)(struct name *h) { \
+    Free(h->allocator, h->slots); \
+    h->slots = NULL; \
+    h->len = h->cap = 0; \
+} \
+\
+Value *JOIN2(name, Get)(struct name *h, u64 key) { \
+    u64 mask = h->cap - 1; \
+    u64 index = TableHash(key) & mask; \
+    for (u32 dist = 1; h->slots[index].dist >= dist; dist += 1) { \
+        if (h->slots[index].key == key) \
+            return &h->slots[index].val; \
+        index = (index + 1) & mask; \
+    } \
+    return NULL; \
+} \
+\
+void JOIN2(name, Set)(struct name *h, u64 key, Value val) { \
+    if (h->len + 1 > h->cap - h->cap / 8) \
+        JOIN2(name, Grow)(h); \
+\
+    u64 mask = h->cap - 1; \
+    u64 index = TableHash(key) & mask; \
+    struct JOIN2(name, Slot) entry; \
+    entry.key = key; \
+    entry.val = val; \
+    entry.dist = 1; \
+    for (;;) { \
+        struct JOIN2(name, Slot) *slot = &h->slots[index]; \
+        if (slot->dist == 0) { \
+            *slot = entry; \
+            h->len += 1; \
+            return; \
+        } \
+\
+        if (slot->dist == entry.dist && slot->key == entry.key) { \
+            slot->val = entry.val; \
+            return; \
+        } \
+\
+        /* Rich entry: take its slot and carry it on down the run */ \
+        if (slot->dist < entry.dist) { \
+            struct JOIN2(name, Slot) displaced = *slot; \
+            *slot = entry; \
+            entry = displaced; \
+        } \
+\
+        index = (index + 1) & mask; \
+        entry.dist += 1; \
+        if (entry.dist == TABLE_MAX_DIST) { \
+            /* NOTE(Brett): only a terrible hash gets here, make room and retry */ \
+            JOIN2(name, Grow)(h); \
+            JOIN2(name, Set)(h, entry.key, entry.val); \
+            return; \
+        } \
+    } \
+} \
+\
+b32 JOIN2(name, Remove)(struct name *h, u64 key) { \
+    u64 mask = h->cap - 1; \
+    u64 index = TableHash(key) & mask; \
+    for (u32 dist = 1; h->slots[index].dist >= dist; dist += 1) { \
+        if (h->slots[index].key == key) { \
+            /* Shift the rest of the run back a slot */ \
+            u64 next = (index + 1) & mask; \
+            while (h->slots[next].dist > 1) { \
+                h->slots[index] = h->slots[next]; \
+                h->slots[index].dist -= 1; \
+                index = next; \
+                next = (next + 1) & mask; \
+            } \
+            h->slots[index].dist = 0; \
+            h->len -= 1; \
+            return true; \
+        } \
+        index = (index + 1) & mask; \
+    } \
+    return false; \
+} \
+\
+void JOIN2(name, Grow)(struct name *h) { \
+    struct name old = *h; \
+    JOIN2(name, InitReserve)(h, old.allocator, old.cap); \
+    for (u64 i = 0; i < old.cap; i += 1) { \
+        if (old.slots[i].dist) \
+            JOIN2(name, Set)(h, old.slots[i].key, old.slots[i].val); \
+    } \
+    JOIN2(name, Free)(&old); \
 }
 
 u64 fnv64a(void const *data, u64 len) {
@@ -289,6 +1626,171 @@ u64 fnv64a(void const *data, u64 len) {
 	return h;
 }
 
+// Word at a time hashing, after wyhash for short keys and xxh3 for long
+// ones. fnv64a above stays for anything that already depends on its values.
+//
+//   <= 16 bytes   two overlapping reads, two 64x64->128 multiplies
+//   <= 128 bytes  one multiply per 16 bytes
+//   longer        8 lanes of 32x32->64 multiply-accumulate, 64 bytes per
+//                 step with SSE2/AVX2, scrambled every 512 bytes
+//
+// The vector and scalar bulk paths compute the same lanes, so a hash never
+// depends on how it was built. The tape cache and snapshot checksums are
+// HashBytes values, bump their versions if the output here ever changes.
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#elif defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
+static const u64 HashSecret[16] = {
+    0xa0761d6478bd642full, 0xe7037ed1a0b428dbull, 0x8ebc6af09c88c6e3ull, 0x589965cc75374cc3ull,
+    0x1d8e4e27c47d124full, 0xbe4ba423396cfeb8ull, 0xcb79e0ef5ec34f5dull, 0x4f1a6b53b2f2e7c1ull,
+    0x9e3779b97f4a7c15ull, 0xc2b2ae3d27d4eb4full, 0x165667b19e3779f9ull, 0x85ebca77c2b2ae63ull,
+    0x27d4eb2f165667c5ull, 0xff51afd7ed558ccdull, 0xc4ceb9fe1a85ec53ull, 0x94d049bb133111ebull,
+};
+
+#define HASH_STRIPE 64
+#define HASH_BLOCK_STRIPES 8
+
+INLINE u64 HashRead64(const u8 *p) { u64 v; memcpy(&v, p, 8); return v; }
+INLINE u64 HashRead32(const u8 *p) { u32 v; memcpy(&v, p, 4); return v; }
+
+// 64x64 -> 128 bit multiply, folded back to 64 bits
+INLINE u64 HashMum(u64 a, u64 b) {
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 r = (unsigned __int128)a * b;
+    return (u64)r ^ (u64)(r >> 64);
+#else
+    u64 ha = a >> 32, hb = b >> 32, la = (u32)a, lb = (u32)b;
+    u64 rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    u64 t = rl + (rm0 << 32), c = t < rl;
+    u64 lo = t + (rm1 << 32);
+    c += lo < t;
+    u64 hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+    return lo ^ hi;
+#endif
+}
+
+INLINE u64 HashShort(const u8 *p, u64 len, u64 seed) {
+    u64 a = 0, b = 0;
+    if (len >= 4) {
+        u64 shift = (len >> 3) << 2;
+        a = (HashRead32(p) << 32) | HashRead32(p + shift);
+        b = (HashRead32(p + len - 4) << 32) | HashRead32(p + len - 4 - shift);
+    } else if (len > 0) {
+        a = ((u64)p[0] << 16) | ((u64)p[len >> 1] << 8) | p[len - 1];
+    }
+    return HashMum(HashSecret[1] ^ len, HashMum(a ^ HashSecret[1], b ^ seed));
+}
+
+INLINE u64 HashMedium(const u8 *p, u64 len, u64 seed) {
+    const u8 *end = p + len;
+    while (end - p > 16) {
+        seed = HashMum(HashRead64(p) ^ HashSecret[1], HashRead64(p + 8) ^ seed);
+        p += 16;
+    }
+    u64 a = HashRead64(end - 16), b = HashRead64(end - 8);
+    return HashMum(HashSecret[1] ^ len, HashMum(a ^ HashSecret[1], b ^ seed));
+}
+
+// Adds `stripes` stripes of 64 bytes into the 8 lanes of `acc`, stripe s
+// keyed with the secret slid along by s words
+INLINE void HashAccumulate(u64 *acc, const u8 *p, const u64 *secret, u32 stripes) {
+#if defined(__AVX2__)
+    __m256i a0 = _mm256_loadu_si256((const __m256i *)acc);
+    __m256i a1 = _mm256_loadu_si256((const __m256i *)(acc + 4));
+    for (u32 s = 0; s < stripes; s += 1) {
+        const u8 *stripe = p + s * HASH_STRIPE;
+        __m256i d0 = _mm256_loadu_si256((const __m256i *)stripe);
+        __m256i d1 = _mm256_loadu_si256((const __m256i *)(stripe + 32));
+        __m256i k0 = _mm256_xor_si256(d0, _mm256_loadu_si256((const __m256i *)(secret + s)));
+        __m256i k1 = _mm256_xor_si256(d1, _mm256_loadu_si256((const __m256i *)(secret + s + 4)));
+        a0 = _mm256_add_epi64(a0, _mm256_mul_epu32(k0, _mm256_srli_epi64(k0, 32)));
+        a1 = _mm256_add_epi64(a1, _mm256_mul_epu32(k1, _mm256_srli_epi64(k1, 32)));
+        a0 = _mm256_add_epi64(a0, _mm256_shuffle_epi32(d0, _MM_SHUFFLE(1, 0, 3, 2)));
+        a1 = _mm256_add_epi64(a1, _mm256_shuffle_epi32(d1, _MM_SHUFFLE(1, 0, 3, 2)));
+    }
+    _mm256_storeu_si256((__m256i *)acc, a0);
+    _mm256_storeu_si256((__m256i *)(acc + 4), a1);
+#elif defined(__SSE2__)
+    __m128i a[4];
+    for (u32 i = 0; i < 4; i += 1)
+        a[i] = _mm_loadu_si128((const __m128i *)(acc + i * 2));
+    for (u32 s = 0; s < stripes; s += 1) {
+        const u8 *stripe = p + s * HASH_STRIPE;
+        for (u32 i = 0; i < 4; i += 1) {
+            __m128i d = _mm_loadu_si128((const __m128i *)(stripe + i * 16));
+            __m128i k = _mm_xor_si128(d, _mm_loadu_si128((const __m128i *)(secret + s + i * 2)));
+            a[i] = _mm_add_epi64(a[i], _mm_mul_epu32(k, _mm_srli_epi64(k, 32)));
+            a[i] = _mm_add_epi64(a[i], _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2)));
+        }
+    }
+    for (u32 i = 0; i < 4; i += 1)
+        _mm_storeu_si128((__m128i *)(acc + i * 2), a[i]);
+#else
+    for (u32 s = 0; s < stripes; s += 1) {
+        const u8 *stripe = p + s * HASH_STRIPE;
+        for (u32 i = 0; i < 8; i += 1) {
+            u64 d = HashRead64(stripe + i * 8);
+            u64 k = d ^ secret[s + i];
+            acc[i] += (k & 0xFFFFFFFF) * (k >> 32);
+            acc[i ^ 1] += d;
+        }
+    }
+#endif
+}
+
+INLINE void HashScramble(u64 *acc) {
+    for (u32 i = 0; i < 8; i += 1) {
+        acc[i] ^= acc[i] >> 47;
+        acc[i] ^= HashSecret[8 + i];
+        acc[i] *= 0x9E3779B1u;
+    }
+}
+
+u64 HashLong(const u8 *p, u64 len, u64 seed) {
+    u64 acc[8];
+    for (u32 i = 0; i < 8; i += 1)
+        acc[i] = HashSecret[i] ^ seed;
+
+    const u64 blockBytes = HASH_STRIPE * HASH_BLOCK_STRIPES;
+    u64 blocks = (len - 1) / blockBytes;
+    for (u64 b = 0; b < blocks; b += 1) {
+        HashAccumulate(acc, p + b * blockBytes, HashSecret, HASH_BLOCK_STRIPES);
+        HashScramble(acc);
+    }
+
+    // Whole stripes left over, then the last 64 bytes even if they overlap
+    u64 done = blocks * blockBytes;
+    u32 stripes = (u32)((len - 1 - done) / HASH_STRIPE);
+    HashAccumulate(acc, p + done, HashSecret, stripes);
+    HashAccumulate(acc, p + len - HASH_STRIPE, HashSecret + 8, 1);
+
+    u64 h = len * 0x9E3779B185EBCA87ull;
+    for (u32 i = 0; i < 8; i += 2)
+        h += HashMum(acc[i] ^ HashSecret[i], acc[i + 1] ^ HashSecret[i + 1]);
+    return TableHash(h);
+}
+
+u64 HashBytes(const void *data, u64 len, u64 seed) {
+    const u8 *p = (const u8 *)data;
+    seed ^= HashMum(seed ^ HashSecret[0], HashSecret[1]);
+    if (len <= 16)
+        return HashShort(p, len, seed);
+    if (len <= 128)
+        return HashMedium(p, len, seed);
+    return HashLong(p, len, seed);
+}
+
+// Fixed width path for 12 byte binary IDs
+INLINE u64 HashId96(const void *data) {
+    const u8 *p = (const u8 *)data;
+    u64 a = HashRead64(p), b = HashRead32(p + 8);
+    return HashMum(HashSecret[1] ^ 12, HashMum(a ^ HashSecret[0], b ^ HashSecret[2]));
+}
+
 struct MapFind {
     i64 hash;
     i64 entry;
@@ -304,6 +1806,7 @@ struct U32Map {
 void U32MapInit(struct U32Map *self, struct Allocator a, u64 cap) {
     self->keys = Alloc(a, sizeof(u64)*cap);
     self->values = Alloc(a, sizeof(u32)*cap);
+    memset(self->keys, 0, sizeof(u64)*cap);
     self->len = 0;
     self->cap = cap;
     self->allocator = a;
@@ -326,6 +1829,7 @@ struct MapFind U32MapFind(struct U32Map *self, u64 key) {
             index = (index+1)%self->cap;
             k = self->keys[index];
         }
+        f.hash = (i64)index; // the empty slot the probe ended on
     }
 
     return f;
@@ -361,6 +1865,295 @@ void U32MapRemove(struct U32Map *self, u64 key) {
     }
 }
 
+// Swiss table version of U32Map. Every slot has a control byte: the low 7
+// bits of the key's hash when full, SWISS_EMPTY or SWISS_DELETED otherwise.
+// Lookups compare 16 control bytes at once and only look at keys whose hash
+// fragment matched, so hits and misses are usually a single group probe.
+// Groups are read unaligned, the first 16 control bytes are mirrored past
+// the end so a group never wraps. Removes leave a tombstone that the next
+// rehash clears. Grows at 7/8 load counting tombstones.
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+    #define SWISS_SLOT_SHIFT 0
+#elif defined(__ARM_NEON)
+    #include <arm_neon.h>
+    #define SWISS_SLOT_SHIFT 2 // 4 mask bits per slot
+#else
+    #define SWISS_SLOT_SHIFT 0
+#endif
+
+#define SWISS_GROUP 16
+#define SWISS_EMPTY 0x80
+#define SWISS_DELETED 0xFE
+
+// Bits for every control byte in the group equal to `h2`
+INLINE u64 SwissMatch(const u8 *ctrl, u8 h2) {
+#if defined(__SSE2__)
+    __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+    return (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)h2)));
+#elif defined(__ARM_NEON)
+    uint8x16_t eq = vceqq_u8(vld1q_u8(ctrl), vdupq_n_u8(h2));
+    u64 mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+    return mask & 0x8888888888888888ull;
+#else
+    u64 mask = 0;
+    for (u32 i = 0; i < SWISS_GROUP; i += 1)
+        mask |= (u64)(ctrl[i] == h2) << i;
+    return mask;
+#endif
+}
+
+// Bits for every empty or deleted control byte, both have the top bit set
+INLINE u64 SwissMatchFree(const u8 *ctrl) {
+#if defined(__SSE2__)
+    return (u32)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+#elif defined(__ARM_NEON)
+    uint8x16_t top = vcgeq_u8(vld1q_u8(ctrl), vdupq_n_u8(0x80));
+    u64 mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(top), 4)), 0);
+    return mask & 0x8888888888888888ull;
+#else
+    u64 mask = 0;
+    for (u32 i = 0; i < SWISS_GROUP; i += 1)
+        mask |= (u64)(ctrl[i] >> 7) << i;
+    return mask;
+#endif
+}
+
+INLINE u64 SwissMatchEmpty(const u8 *ctrl) {
+    return SwissMatch(ctrl, SWISS_EMPTY);
+}
+
+INLINE u32 SwissSlot(u64 mask) {
+    return (u32)__builtin_ctzll(mask) >> SWISS_SLOT_SHIFT;
+}
+
+struct SwissSlot {
+    u64 key;
+    u32 value;
+};
+
+struct SwissMap {
+    u8 *ctrl; // cap + SWISS_GROUP bytes
+    struct SwissSlot *slots;
+    u64 len, cap, deleted;
+    struct Allocator allocator;
+};
+
+void SwissMapInit(struct SwissMap *self, struct Allocator a, u64 cap) {
+    u64 pow2 = SWISS_GROUP;
+    while (pow2 - pow2 / 8 < cap) pow2 *= 2;
+    self->ctrl = Alloc(a, pow2 + SWISS_GROUP);
+    self->slots = Alloc(a, sizeof(struct SwissSlot)*pow2);
+    memset(self->ctrl, SWISS_EMPTY, pow2 + SWISS_GROUP);
+    self->len = 0;
+    self->deleted = 0;
+    self->cap = pow2;
+    self->allocator = a;
+}
+
+void SwissMapFree(struct SwissMap *self) {
+    Free(self->allocator, self->ctrl);
+    Free(self->allocator, self->slots);
+    self->ctrl = NULL;
+    self->slots = NULL;
+    self->len = self->cap = self->deleted = 0;
+}
+
+INLINE void SwissSetCtrl(struct SwissMap *self, u64 index, u8 c) {
+    self->ctrl[index] = c;
+    if (index < SWISS_GROUP)
+        self->ctrl[self->cap + index] = c;
+}
+
+// Same result as U32MapFind: `entry` is the slot holding `key` or -1, and
+// `hash` is the slot it would go in otherwise
+struct MapFind SwissMapFind(struct SwissMap *self, u64 key) {
+    struct MapFind f = {-1, -1};
+    u64 hash = TableHash(key);
+    u8 h2 = (u8)(hash & 0x7F);
+    u64 mask = self->cap - 1;
+    u64 pos = (hash >> 7) & mask;
+
+    for (u64 step = SWISS_GROUP; ; step += SWISS_GROUP) {
+        const u8 *group = self->ctrl + pos;
+        for (u64 m = SwissMatch(group, h2); m; m &= m - 1) {
+            u64 index = (pos + SwissSlot(m)) & mask;
+            if (self->slots[index].key == key) {
+                f.entry = (i64)index;
+                return f;
+            }
+        }
+
+        u64 available = SwissMatchFree(group);
+        if (f.hash < 0 && available)
+            f.hash = (i64)((pos + SwissSlot(available)) & mask);
+
+        // An empty slot ends the probe, the key would have gone there
+        if (SwissMatchEmpty(group))
+            return f;
+
+        pos = (pos + step) & mask;
+    }
+}
+
+u32 *SwissMapGet(struct SwissMap *self, u64 key) {
+    i64 index = SwissMapFind(self, key).entry;
+    if (index >= 0)
+        return &self->slots[index].value;
+    return NULL;
+}
+
+void SwissMapRehash(struct SwissMap *self, u64 reserve);
+
+void SwissMapSet(struct SwissMap *self, u64 key, u32 value) {
+    struct MapFind f = SwissMapFind(self, key);
+    if (f.entry >= 0) {
+        self->slots[f.entry].value = value;
+        return;
+    }
+
+    if (self->len + self->deleted + 1 > self->cap - self->cap / 8) {
+        // Mostly tombstones: clean up in place, otherwise double
+        SwissMapRehash(self, self->len * 2 < self->cap ? self->cap / 2 : self->cap + 1);
+        f = SwissMapFind(self, key);
+    }
+
+    if (self->ctrl[f.hash] == SWISS_DELETED)
+        self->deleted -= 1;
+    SwissSetCtrl(self, (u64)f.hash, (u8)(TableHash(key) & 0x7F));
+    self->slots[f.hash].key = key;
+    self->slots[f.hash].value = value;
+    self->len += 1;
+}
+
+void SwissMapRemove(struct SwissMap *self, u64 key) {
+    i64 index = SwissMapFind(self, key).entry;
+    if (index >= 0) {
+        SwissSetCtrl(self, (u64)index, SWISS_DELETED);
+        self->len -= 1;
+        self->deleted += 1;
+    }
+}
+
+// Moves everything into a new table with room for `reserve` keys
+void SwissMapRehash(struct SwissMap *self, u64 reserve) {
+    struct SwissMap old = *self;
+    SwissMapInit(self, old.allocator, reserve);
+    for (u64 i = 0; i < old.cap; i += 1) {
+        if (!(old.ctrl[i] & 0x80))
+            SwissMapSet(self, old.slots[i].key, old.slots[i].value);
+    }
+    SwissMapFree(&old);
+}
+
+// A view into someone else's bytes, usually the JSON response it was parsed
+// from. `flags` records whether the bytes still hold escapes that need to be
+// decoded before display, see StrUnescape in decode.h.
+struct Str {
+    const char *data;
+    u32 len;
+    u32 flags;
+};
+
+#define STR_ESCAPED 0x1
+
+#define StrArg(s) (int)(s).len, (s).data
+
+INLINE struct Str StrMake(const char *data, u32 len, u32 flags) {
+    struct Str s = { data, len, flags };
+    return s;
+}
+
+// Empty strs can have NULL data, which memcmp isn't allowed to see
+INLINE b32 StrEq(struct Str lhs, struct Str rhs) {
+    if (lhs.len != rhs.len)
+        return false;
+    return lhs.len == 0 || memcmp(lhs.data, rhs.data, lhs.len) == 0;
+}
+
+INLINE b32 StrEqC(struct Str lhs, const char *rhs) {
+    size_t len = strlen(rhs);
+    if (lhs.len != len)
+        return false;
+    return len == 0 || memcmp(lhs.data, rhs, len) == 0;
+}
+
+// 32-bit pointers relative to the base of a block of memory, usually
+// Memory.buffer. A RelPtr(Type) is half the size of a pointer and stays
+// valid when the whole block is written out and mapped back at another
+// address. Offsets count RELPTR_ALIGN byte units, so they reach 64GB past
+// the base, all of MEMORY_RESERVE, and anything pointed at has to be
+// RELPTR_ALIGN aligned (everything from an Arena or a Pool is). Offset 0 is
+// NULL, so the base itself can't be pointed at. A target that is misaligned
+// or out of reach is stored as NULL and RelSet evaluates to false.
+//
+//     RelPtrDecl(ListRef, struct List);
+//     struct Card { ListRef list; struct RelStr name; };
+//     RelSet(memory->buffer, card->list, list);
+//     struct List *list = RelGet(memory->buffer, card->list);
+//     struct Str name = RelStrGet(memory->buffer, card->name);
+//
+// Every RelPtr(Type) is its own struct type, so declare a name with
+// RelPtrDecl for anything that gets assigned or passed around.
+//
+// Strings are byte aligned, so a RelStr counts bytes and only reaches the
+// first 4GB of its base. Give strings a pool of their own to be the base,
+// the way a snapshot does, rather than counting from Memory.buffer.
+#define RELPTR_SHIFT 4
+#define RELPTR_ALIGN (1 << RELPTR_SHIFT)
+
+// relType only carries the type for RelGet. It's a pointer so Type can be
+// incomplete, and packed so it doesn't make the struct 8 byte aligned.
+#define RelPtr(Type) struct { u32 offset; Type *relType[0]; } __attribute__((packed, aligned(4)))
+#define RelPtrDecl(Name, Type) typedef RelPtr(Type) Name
+
+#define RelIsNull(rel) ((rel).offset == 0)
+#define RelGet(base, rel) ((__typeof__((rel).relType[0]))RelResolve((base), (rel).offset))
+#define RelSet(base, rel, ptr) ({ \
+    __typeof__((rel).relType[0]) _target = (ptr); \
+    (rel).offset = RelOffset((base), _target); \
+    (b32)(!_target || (rel).offset != 0); \
+})
+
+INLINE void *RelResolve(const void *base, u32 offset) {
+    return offset ? (u8 *)base + ((u64)offset << RELPTR_SHIFT) : NULL;
+}
+
+// 0 for NULL and for targets a RelPtr can't hold
+INLINE u32 RelOffset(const void *base, const void *ptr) {
+    if (!ptr || ptr <= base)
+        return 0;
+    u64 distance = (u64)((const u8 *)ptr - (const u8 *)base);
+    if ((distance & (RELPTR_ALIGN - 1)) || (distance >> RELPTR_SHIFT) > 0xFFFFFFFFull)
+        return 0;
+    return (u32)(distance >> RELPTR_SHIFT);
+}
+
+struct RelStr {
+    u32 offset;
+    u32 len : 31;
+    u32 escaped : 1; // STR_ESCAPED
+};
+
+// An empty RelStr for strings that are out of reach of `base`, so check
+// the length when that can happen
+INLINE struct RelStr RelStrMake(const void *base, struct Str s) {
+    struct RelStr rel = {0};
+    if (s.len && (const void *)s.data >= base) {
+        u64 distance = (u64)((const u8 *)s.data - (const u8 *)base);
+        if (distance + s.len > 0xFFFFFFFFull || s.len >= 0x80000000u)
+            return rel;
+        rel.offset = (u32)distance;
+        rel.len = s.len;
+        rel.escaped = (s.flags & STR_ESCAPED) != 0;
+    }
+    return rel;
+}
+
+INLINE struct Str RelStrGet(const void *base, struct RelStr rel) {
+    return StrMake((const char *)base + rel.offset, rel.len, rel.escaped ? STR_ESCAPED : 0);
+}
+
 #define InvalidCodePoint 0xFFFD
 
 // WARNING: this function cannot handle a buffer where `len = 0`
@@ -567,7 +2360,7 @@ b32 CmpV4(v4 lhs, v4 rhs) {
     return lhs.x == rhs.x && lhs.y == rhs.y && lhs.z == rhs.z && lhs.w == rhs.w;
 }
 
-static unsigned GetTimems() {
+INLINE unsigned GetTimems() {
 #ifdef PLATFORM_WINDOWS
     return (unsigned)GetTickCount();
 #else
@@ -589,7 +2382,7 @@ typedef struct {
     double counter_scale;
 } usTimer;
 
-static void usTimerInit(usTimer* timer) {
+INLINE void usTimerInit(usTimer* timer) {
 #if defined(PLATFORM_WINDOWS)
     unsigned long performance_frequency;
 
@@ -617,7 +2410,7 @@ static void usTimerInit(usTimer* timer) {
 #endif
 }
 
-static unsigned long GetTimeus(usTimer* timer) {
+INLINE unsigned long GetTimeus(usTimer* timer) {
 #if defined(PLATFORM_WINDOWS)
     unsigned long performance_count;
 
@@ -686,6 +2479,12 @@ struct RenderCommands {
 
     struct RenderEntryQuads *currentQuads;
     struct RenderEntryTexturedQuads *currentTexturedQuads;
+
+    // Optional. When set, the buffers above start at these arenas' bases
+    // and grow by committing more of them instead of running out.
+    struct Arena *commandArena;
+    struct Arena *vertexArena;
+    struct Arena *texturedVertArena;
 };
 
 INLINE struct RenderCommands RenderCommandsInit(
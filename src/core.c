@@ -19,6 +19,9 @@ enum Key {
 
     K_Escape,
 
+    K_F1, // memory overlay
+    K_F2, // dump allocation stats
+
     _K_COUNT
 };
 
@@ -39,6 +42,7 @@ struct Input {
     f32 dragStartX, dragStartY;
     u8 mouseButtons[_MB_COUNT];
     u8 keys[_K_COUNT];
+    u8 lastKeys[_K_COUNT]; // keys as of the previous Tick
     b8 shift, alt, control, isDragging, wasDragging;
 };
 
@@ -64,11 +68,23 @@ enum Mode {
 struct State {
     struct Frame frame;
     enum Mode mode;
+    b32 showMemory;
 };
 
+// Address space the platform reserves for Memory. Only what's used is ever
+// committed.
+#define MEMORY_RESERVE GB(64)
+
 struct Memory {
-    void *buffer;
-    void *scratch;
+    void *buffer; // the base RelPtr offsets into Memory count from
+    struct Arena commands; // render command buffer, at the start of buffer
+    struct Arena scratch; // reset at the start of every Tick
+    struct SlabCache slabs; // backs the per-board object pools
+    struct Pool models;
+
+    // What everything else allocates through, tagged for the memory overlay
+    struct Allocator frame, model, glyphs;
+    struct AllocStats frameStats, modelStats, glyphStats;
 };
 
 enum Label {
@@ -90,6 +106,35 @@ INLINE b32 KeyPressed(struct Input *input, enum Key key) {
     return input->keys[key];
 }
 
+INLINE b32 KeyWentDown(struct Input *input, enum Key key) {
+    return input->keys[key] && !input->lastKeys[key];
+}
+
+// Splits the range the platform reserved into the command buffer, slabs for
+// the object pools and frame scratch, each committed as it grows and ending
+// in a guard, and sets up the tagged allocators. Returns false if the first
+// pages of the command buffer can't be committed.
+b32 MemoryInit(struct Memory *memory, void *block, u64 size) {
+    u8 *base = block;
+    u64 commandBytes = size / 16;
+    u64 slabBytes = size / 16 * 7;
+
+    memory->buffer = block;
+    ArenaInitReserved(&memory->commands, base, commandBytes, 0);
+    SlabCacheInitReserved(&memory->slabs, base + commandBytes, slabBytes, VM_HUGE_PAGES);
+    ArenaInitReserved(&memory->scratch, base + commandBytes + slabBytes, size - commandBytes - slabBytes, 0);
+    PoolInit(&memory->models, &memory->slabs, DefaultHeapAllocator());
+
+    AllocStatsInit(&memory->frameStats, "frame", ArenaAllocator(&memory->scratch));
+    AllocStatsInitPool(&memory->modelStats, "model", &memory->models);
+    AllocStatsInit(&memory->glyphStats, "glyphs", DefaultHeapAllocator());
+    memory->frame = TrackAllocator(&memory->frameStats);
+    memory->model = TrackAllocator(&memory->modelStats);
+    memory->glyphs = TrackAllocator(&memory->glyphStats);
+
+    return ArenaCommit(&memory->commands, MB(1));
+}
+
 void DefaultState(struct State *state) {
     state->mode = Mode_Boards;
 }
@@ -155,6 +200,32 @@ void DrawSpinner(
     }
 }
 
+#ifdef DIAGNOSTICS
+void DrawMemoryOverlay(struct RenderCommands *commands) {
+    static const u32 backColor = RGBA(0x10, 0x10, 0x10, 0xd0);
+    static const u32 textColor = RGB(0xe8, 0xde, 0xd9);
+    static const f32 lineHeight = 16.0;
+
+    u32 lines = 1;
+    for (struct AllocStats *stats = AllocStatsFirst(); stats; stats = stats->next)
+        lines += 1;
+
+    v2 pos = V2(trayPadding, topPadding);
+    PushRect(commands, pos, V2(460, lines * lineHeight + 8), QuadKind_Normal, backColor);
+
+    f32 y = pos.y + lineHeight;
+    DrawText(commands, V2(pos.x + 4, y), textColor, textFont, "tag        live KB    peak KB     allocs      frees");
+    for (struct AllocStats *stats = AllocStatsFirst(); stats; stats = stats->next) {
+        char line[128];
+        snprintf(line, sizeof(line), "%-8s %9.1f  %9.1f  %9llu  %9llu", stats->tag,
+            stats->live / 1024.0, stats->peak / 1024.0,
+            (unsigned long long)stats->allocs, (unsigned long long)stats->frees);
+        y += lineHeight;
+        DrawText(commands, V2(pos.x + 4, y), textColor, textFont, line);
+    }
+}
+#endif
+
 void tickBoards(
     struct State *state,
     struct Time *time,
@@ -202,6 +273,8 @@ void Tick(
         return;
     }
 
+    FreeAll(memory->frame);
+
     headerFont = commands->settings.headerFont;
     textFont = commands->settings.textFont;
 
@@ -231,5 +304,16 @@ void Tick(
         tickBoard(state, time, input, memory, commands);
     } break;
     }
+
+#ifdef DIAGNOSTICS
+    if (KeyWentDown(input, K_F1))
+        state->showMemory = !state->showMemory;
+    if (KeyWentDown(input, K_F2))
+        AllocStatsDump("memory.txt");
+    if (state->showMemory)
+        DrawMemoryOverlay(commands);
+#endif
+
+    memcpy(input->lastKeys, input->keys, sizeof(input->keys));
  
 }
@@ -0,0 +1,238 @@
+// On-demand access to a JSON document without tokenizing it.
+//
+// A cursor is just a position in the source. Finding a field scans forward
+// only until that key, and every value in the way is skipped by bracket
+// matching, so nothing is allocated and subtrees nobody asks for are only
+// ever looked at by the skip loop.
+//
+//     struct JsonCursor boards = JsonCursorInit(json, len), board;
+//     while (JsonArrayNext(&boards, &board)) {
+//         struct JsonCursor value;
+//         if (JsonObjectFind(&board, "name", &value))
+//             JsonGetString(&value, &name);
+//     }
+//
+// Requires common.h and decode.h.
+
+struct JsonCursor {
+    const char *json;
+    u32 len;
+    u32 start; // first byte of the value
+    u32 next;  // arrays: next element, objects: where the last find stopped
+};
+
+INLINE u32 JsonSkipSpace(const char *json, u32 len, u32 pos) {
+    while (pos < len && (json[pos] == ' ' || json[pos] == '\n' || json[pos] == '\r' || json[pos] == '\t'))
+        pos += 1;
+    return pos;
+}
+
+// Flags quotes and brackets in the next 16 bytes
+INLINE u32 JsonBracketMask(const u8 *p) {
+#if defined(__SSE2__)
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    __m128i folded = _mm_or_si128(v, _mm_set1_epi8(0x20)); // '[' -> '{', ']' -> '}'
+    __m128i hits = _mm_or_si128(
+        _mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+        _mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{')), _mm_cmpeq_epi8(folded, _mm_set1_epi8('}'))));
+    return (u32)_mm_movemask_epi8(hits);
+#else
+    u32 mask = 0;
+    for (u32 i = 0; i < 16; i += 1) {
+        u8 c = p[i] | 0x20;
+        if (p[i] == '"' || c == '{' || c == '}')
+            mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+// `pos` is the opening quote. Returns the position after the closing quote.
+INLINE u32 JsonSkipString(const char *json, u32 len, u32 pos) {
+    pos += 1;
+    for (;;) {
+        const char *quote = memchr(json + pos, '"', len - pos);
+        if (!quote)
+            return len;
+
+        u32 at = (u32)(quote - json);
+        u32 backslashes = 0;
+        while (at - backslashes > pos && json[at - backslashes - 1] == '\\')
+            backslashes += 1;
+
+        pos = at + 1;
+        if (!(backslashes & 1))
+            return pos;
+    }
+}
+
+// Returns the position after the value starting at `pos`
+u32 JsonSkipValue(const char *json, u32 len, u32 pos) {
+    pos = JsonSkipSpace(json, len, pos);
+    if (pos >= len)
+        return len;
+
+    char c = json[pos];
+    if (c == '"')
+        return JsonSkipString(json, len, pos);
+
+    if (c != '{' && c != '[') {
+        while (pos < len && json[pos] != ',' && json[pos] != '}' && json[pos] != ']' &&
+                json[pos] != ' ' && json[pos] != '\n' && json[pos] != '\r' && json[pos] != '\t')
+            pos += 1;
+        return pos;
+    }
+
+    u32 depth = 0;
+    while (pos < len) {
+        if (pos + 16 <= len) {
+            u32 mask = JsonBracketMask((const u8 *)json + pos);
+            if (!mask) {
+                pos += 16;
+                continue;
+            }
+            pos += __builtin_ctz(mask);
+        }
+
+        c = json[pos];
+        if (c == '"') {
+            pos = JsonSkipString(json, len, pos);
+            continue;
+        }
+
+        if (c == '{' || c == '[') {
+            depth += 1;
+        } else if (c == '}' || c == ']') {
+            depth -= 1;
+            if (depth == 0)
+                return pos + 1;
+        }
+        pos += 1;
+    }
+
+    return len;
+}
+
+INLINE struct JsonCursor JsonCursorAt(const char *json, u32 len, u32 pos) {
+    struct JsonCursor cursor;
+    cursor.json = json;
+    cursor.len = len;
+    cursor.start = JsonSkipSpace(json, len, pos);
+    cursor.next = cursor.start;
+    return cursor;
+}
+
+INLINE struct JsonCursor JsonCursorInit(const char *json, u32 len) {
+    return JsonCursorAt(json, len, 0);
+}
+
+INLINE char JsonCursorType(struct JsonCursor *cursor) {
+    return cursor->start < cursor->len ? cursor->json[cursor->start] : 0;
+}
+
+// Steps to the next element of the array under `array`. Returns false once
+// the array is exhausted or if `array` isn't one.
+b32 JsonArrayNext(struct JsonCursor *array, struct JsonCursor *element) {
+    const char *json = array->json;
+    u32 len = array->len;
+
+    if (array->next == array->start) {
+        if (JsonCursorType(array) != '[')
+            return false;
+        array->next += 1;
+    }
+
+    u32 pos = JsonSkipSpace(json, len, array->next);
+    if (pos < len && json[pos] == ',')
+        pos = JsonSkipSpace(json, len, pos + 1);
+    if (pos >= len || json[pos] == ']') {
+        array->next = pos;
+        return false;
+    }
+
+    *element = JsonCursorAt(json, len, pos);
+    array->next = JsonSkipValue(json, len, pos);
+    return true;
+}
+
+// Looks for `key` among the fields of the object under `object`. The search
+// starts where the previous find stopped and wraps around, so reading
+// fields in document order scans the object once.
+b32 JsonObjectFind(struct JsonCursor *object, const char *key, struct JsonCursor *value) {
+    const char *json = object->json;
+    u32 len = object->len;
+    u32 keyLen = (u32)strlen(key);
+
+    if (JsonCursorType(object) != '{')
+        return false;
+
+    u32 first = object->start + 1;
+    u32 pos = object->next == object->start ? first : object->next;
+    b32 wrapped = pos == first;
+    u32 stop = pos;
+
+    for (;;) {
+        pos = JsonSkipSpace(json, len, pos);
+        if (pos < len && json[pos] == ',')
+            pos = JsonSkipSpace(json, len, pos + 1);
+
+        if (pos >= len || json[pos] != '"') {
+            // End of the object: go around once to the fields before `stop`
+            if (wrapped)
+                return false;
+            wrapped = true;
+            pos = first;
+            continue;
+        }
+
+        if (wrapped && pos >= stop && stop != first)
+            return false;
+
+        u32 keyStart = pos + 1;
+        u32 keyEnd = JsonSkipString(json, len, pos) - 1;
+
+        pos = JsonSkipSpace(json, len, keyEnd + 1);
+        if (pos >= len || json[pos] != ':')
+            return false;
+        pos = JsonSkipSpace(json, len, pos + 1);
+
+        u32 valueEnd = JsonSkipValue(json, len, pos);
+
+        if (keyEnd - keyStart == keyLen && memcmp(json + keyStart, key, keyLen) == 0) {
+            *value = JsonCursorAt(json, len, pos);
+            object->next = valueEnd;
+            return true;
+        }
+
+        pos = valueEnd;
+    }
+}
+
+// Value readers. All of them return false if the value has another type.
+
+b32 JsonGetString(struct JsonCursor *value, struct Str *out) {
+    if (JsonCursorType(value) != '"')
+        return false;
+
+    u32 start = value->start + 1;
+    u32 end = JsonSkipString(value->json, value->len, value->start) - 1;
+    i32 flags = JsonStringScan((const u8 *)value->json + start, end - start);
+    if (flags < 0)
+        return false;
+
+    *out = StrMake(value->json + start, end - start, (u32)flags);
+    return true;
+}
+
+b32 JsonGetF64(struct JsonCursor *value, f64 *out) {
+    u32 end = JsonSkipValue(value->json, value->len, value->start);
+    return JsonParseF64(value->json + value->start, end - value->start, out);
+}
+
+b32 JsonGetBool(struct JsonCursor *value, b32 *out) {
+    char c = JsonCursorType(value);
+    if (c != 't' && c != 'f')
+        return false;
+    *out = c == 't';
+    return true;
+}
@@ -27,6 +27,7 @@ enum jsmnerr {
  * type		type (object, array, string etc.)
  * start	start position in JSON data string
  * end		end position in JSON data string
+ * next		index of the token after this one and all of its children
  */
 typedef struct {
 	jsmntype_t type;
@@ -36,6 +37,9 @@ typedef struct {
 #ifdef JSMN_PARENT_LINKS
 	int parent;
 #endif
+#ifdef JSMN_NEXT_LINKS
+	int next;
+#endif
 } jsmntok_t;
 
 /**
@@ -46,6 +50,7 @@ typedef struct {
 	unsigned int pos; /* offset in the JSON string */
 	unsigned int toknext; /* next token to allocate */
 	int toksuper; /* superior token node, e.g parent object or array */
+	unsigned int idxnext; /* next structural index, see jsmn_parse_index */
 } jsmn_parser;
 
 /**
@@ -74,6 +79,10 @@ static jsmntok_t *jsmn_alloc_token(jsmn_parser *parser,
 	tok->size = 0;
 #ifdef JSMN_PARENT_LINKS
 	tok->parent = -1;
+#endif
+#ifdef JSMN_NEXT_LINKS
+	/* Containers move this past their children when they close */
+	tok->next = parser->toknext;
 #endif
 	return tok;
 }
@@ -254,6 +263,9 @@ int jsmn_parse(jsmn_parser *parser, const char *js, size_t len,
 							return JSMN_ERROR_INVAL;
 						}
 						token->end = parser->pos + 1;
+#ifdef JSMN_NEXT_LINKS
+						token->next = parser->toknext;
+#endif
 						parser->toksuper = token->parent;
 						break;
 					}
@@ -274,6 +286,9 @@ int jsmn_parse(jsmn_parser *parser, const char *js, size_t len,
 						}
 						parser->toksuper = -1;
 						token->end = parser->pos + 1;
+#ifdef JSMN_NEXT_LINKS
+						token->next = parser->toknext;
+#endif
 						break;
 					}
 				}
@@ -370,5 +385,951 @@ void jsmn_init(jsmn_parser *parser) {
 	parser->pos = 0;
 	parser->toknext = 0;
 	parser->toksuper = -1;
+	parser->idxnext = 0;
+}
+
+
+/**
+ * Structural index backend.
+ *
+ * Stage one scans the input 64 bytes at a time and records the offset of
+ * every structural character ({}[]:,), both quotes of every string and the
+ * first byte of every primitive. Stage two walks that index and produces
+ * the same token stream as jsmn_parse without touching the bytes in
+ * between, so string bodies are never looked at twice.
+ *
+ * Escapes inside strings are not validated here; that happens when the
+ * string is materialized.
+ */
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__PCLMUL__)
+#include <wmmintrin.h>
+#endif
+
+#ifndef JSMN_MAX_DEPTH
+#define JSMN_MAX_DEPTH 1024
+#endif
+
+typedef struct {
+	uint64_t quote;
+	uint64_t backslash;
+	uint64_t whitespace;
+	uint64_t op;
+} jsmn_block;
+
+#if defined(__AVX2__)
+static uint64_t jsmn_eq_mask(__m256i lo, __m256i hi, char c) {
+	__m256i v = _mm256_set1_epi8(c);
+	uint64_t l = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, v));
+	uint64_t h = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, v));
+	return l | (h << 32);
+}
+
+static void jsmn_classify(const uint8_t *p, jsmn_block *b) {
+	__m256i lo = _mm256_loadu_si256((const __m256i *)p);
+	__m256i hi = _mm256_loadu_si256((const __m256i *)(p + 32));
+	b->quote = jsmn_eq_mask(lo, hi, '"');
+	b->backslash = jsmn_eq_mask(lo, hi, '\\');
+	b->whitespace = jsmn_eq_mask(lo, hi, ' ') | jsmn_eq_mask(lo, hi, '\t') |
+		jsmn_eq_mask(lo, hi, '\n') | jsmn_eq_mask(lo, hi, '\r');
+	b->op = jsmn_eq_mask(lo, hi, '{') | jsmn_eq_mask(lo, hi, '}') |
+		jsmn_eq_mask(lo, hi, '[') | jsmn_eq_mask(lo, hi, ']') |
+		jsmn_eq_mask(lo, hi, ':') | jsmn_eq_mask(lo, hi, ',');
+}
+#elif defined(__SSE2__)
+static uint64_t jsmn_eq_mask(const __m128i *v, char c) {
+	__m128i s = _mm_set1_epi8(c);
+	uint64_t m0 = (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v[0], s));
+	uint64_t m1 = (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v[1], s));
+	uint64_t m2 = (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v[2], s));
+	uint64_t m3 = (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v[3], s));
+	return m0 | (m1 << 16) | (m2 << 32) | (m3 << 48);
+}
+
+static void jsmn_classify(const uint8_t *p, jsmn_block *b) {
+	__m128i v[4];
+	v[0] = _mm_loadu_si128((const __m128i *)p);
+	v[1] = _mm_loadu_si128((const __m128i *)(p + 16));
+	v[2] = _mm_loadu_si128((const __m128i *)(p + 32));
+	v[3] = _mm_loadu_si128((const __m128i *)(p + 48));
+	b->quote = jsmn_eq_mask(v, '"');
+	b->backslash = jsmn_eq_mask(v, '\\');
+	b->whitespace = jsmn_eq_mask(v, ' ') | jsmn_eq_mask(v, '\t') |
+		jsmn_eq_mask(v, '\n') | jsmn_eq_mask(v, '\r');
+	b->op = jsmn_eq_mask(v, '{') | jsmn_eq_mask(v, '}') |
+		jsmn_eq_mask(v, '[') | jsmn_eq_mask(v, ']') |
+		jsmn_eq_mask(v, ':') | jsmn_eq_mask(v, ',');
+}
+#else
+static void jsmn_classify(const uint8_t *p, jsmn_block *b) {
+	int i;
+	b->quote = b->backslash = b->whitespace = b->op = 0;
+	for (i = 0; i < 64; i++) {
+		uint64_t bit = 1ULL << i;
+		switch (p[i]) {
+			case '"': b->quote |= bit; break;
+			case '\\': b->backslash |= bit; break;
+			case ' ': case '\t': case '\n': case '\r':
+				b->whitespace |= bit; break;
+			case '{': case '}': case '[': case ']': case ':': case ',':
+				b->op |= bit; break;
+		}
+	}
+}
+#endif
+
+/**
+ * Bit i of the result is the xor of bits 0..i of the input. With PCLMUL this
+ * is a single carry-less multiply by all ones.
+ */
+static uint64_t jsmn_prefix_xor(uint64_t bits) {
+#if defined(__PCLMUL__)
+	__m128i all = _mm_set1_epi8((char)0xFF);
+	__m128i r = _mm_clmulepi64_si128(_mm_set_epi64x(0, (long long)bits), all, 0);
+	return (uint64_t)_mm_cvtsi128_si64(r);
+#else
+	bits ^= bits << 1;
+	bits ^= bits << 2;
+	bits ^= bits << 4;
+	bits ^= bits << 8;
+	bits ^= bits << 16;
+	bits ^= bits << 32;
+	return bits;
+#endif
+}
+
+/**
+ * Returns the characters escaped by an odd run of backslashes. Runs that
+ * start on an even bit are separated from those on an odd bit by letting the
+ * carry of an add ripple through each run.
+ */
+static uint64_t jsmn_escaped(uint64_t backslash, uint64_t *prev_escaped) {
+	const uint64_t even_bits = 0x5555555555555555ULL;
+	uint64_t follows_escape, odd_starts, even_seqs, invert;
+
+	backslash &= ~*prev_escaped;
+	follows_escape = (backslash << 1) | *prev_escaped;
+	odd_starts = backslash & ~even_bits & ~follows_escape;
+	*prev_escaped = __builtin_add_overflow(odd_starts, backslash, &even_seqs);
+	invert = even_seqs << 1;
+	return (even_bits ^ invert) & follows_escape;
+}
+
+/* Writes 32 bit positions to `narrow` or, when it is NULL, 64 bit ones to `wide` */
+static inline int jsmn_index_positions(const char *js, size_t len,
+		unsigned int *narrow, uint64_t *wide) {
+	const uint8_t *p = (const uint8_t *)js;
+	const char *nul = memchr(js, '\0', len);
+	uint64_t prev_escaped = 0, prev_in_string = 0, prev_scalar = 0;
+	unsigned int count = 0;
+	size_t base;
+
+	if (nul) len = (size_t)(nul - js);
+
+	for (base = 0; base < len; base += 64) {
+		uint8_t tail[64];
+		const uint8_t *block = p + base;
+		jsmn_block b;
+		uint64_t escaped, quote, in_string, outside, scalar, structural;
+
+		if (len - base < 64) {
+			memset(tail, ' ', sizeof(tail));
+			memcpy(tail, block, len - base);
+			block = tail;
+		}
+
+		jsmn_classify(block, &b);
+
+		escaped = jsmn_escaped(b.backslash, &prev_escaped);
+		quote = b.quote & ~escaped;
+		in_string = jsmn_prefix_xor(quote) ^ prev_in_string;
+		prev_in_string = (uint64_t)((int64_t)in_string >> 63);
+
+		outside = ~(in_string | quote);
+		scalar = outside & ~(b.op | b.whitespace);
+		structural = (b.op & outside) | quote |
+			(scalar & ~((scalar << 1) | prev_scalar));
+		prev_scalar = scalar >> 63;
+
+		while (structural) {
+			if (narrow)
+				narrow[count++] = (unsigned int)(base + __builtin_ctzll(structural));
+			else
+				wide[count++] = base + __builtin_ctzll(structural);
+			structural &= structural - 1;
+		}
+	}
+
+	return (int)count;
+}
+
+/**
+ * Builds the structural index of a JSON string. `indices` must have room for
+ * `len` entries. Returns the number of indices written, or JSMN_ERROR_INVAL
+ * when `len` doesn't fit in 32 bits, use jsmn_index64 for those.
+ */
+int jsmn_index(const char *js, size_t len, unsigned int *indices) {
+	if ((uint64_t)len > UINT32_MAX)
+		return JSMN_ERROR_INVAL;
+	return jsmn_index_positions(js, len, indices, NULL);
+}
+
+/**
+ * jsmn_index with 64 bit positions, for jsmn_tape_build on documents past
+ * 4 GB.
+ */
+int jsmn_index64(const char *js, size_t len, uint64_t *indices) {
+	return jsmn_index_positions(js, len, NULL, indices);
+}
+
+/**
+ * Fills tokens from a structural index built by jsmn_index. There is never
+ * more than one token per index, so `num_indices` tokens is always enough.
+ * Like jsmn_parse it can be called again with a larger token array after
+ * returning JSMN_ERROR_NOMEM.
+ */
+int jsmn_parse_index(jsmn_parser *parser, const char *js, size_t len,
+		const unsigned int *indices, unsigned int num_indices,
+		jsmntok_t *tokens, unsigned int num_tokens) {
+	int stack[JSMN_MAX_DEPTH];
+	int depth = 0;
+	unsigned int k;
+	jsmntok_t *token;
+
+	/* Resuming: containers still open are the ones without an end */
+	for (k = 0; k < parser->toknext; k++) {
+		token = &tokens[k];
+		if ((token->type == JSMN_OBJECT || token->type == JSMN_ARRAY) &&
+				token->end == -1) {
+			if (depth == JSMN_MAX_DEPTH)
+				return JSMN_ERROR_NOMEM;
+			stack[depth++] = k;
+		}
+	}
+
+	for (k = parser->idxnext; k < num_indices; k++) {
+		unsigned int pos = indices[k];
+		char c = js[pos];
+
+		parser->idxnext = k;
+
+		switch (c) {
+			case '{': case '[':
+				if (depth == JSMN_MAX_DEPTH)
+					return JSMN_ERROR_NOMEM;
+				token = jsmn_alloc_token(parser, tokens, num_tokens);
+				if (token == NULL)
+					return JSMN_ERROR_NOMEM;
+				if (parser->toksuper != -1) {
+					tokens[parser->toksuper].size++;
+#ifdef JSMN_PARENT_LINKS
+					token->parent = parser->toksuper;
+#endif
+				}
+				token->type = (c == '{' ? JSMN_OBJECT : JSMN_ARRAY);
+				token->start = pos;
+				parser->toksuper = parser->toknext - 1;
+				stack[depth++] = parser->toksuper;
+				break;
+			case '}': case ']':
+				if (depth == 0)
+					return JSMN_ERROR_INVAL;
+				token = &tokens[stack[--depth]];
+				if (token->type != (c == '}' ? JSMN_OBJECT : JSMN_ARRAY))
+					return JSMN_ERROR_INVAL;
+				token->end = pos + 1;
+#ifdef JSMN_NEXT_LINKS
+				token->next = parser->toknext;
+#endif
+				parser->toksuper = depth > 0 ? stack[depth - 1] : -1;
+				break;
+			case '\"':
+				/* The closing quote is always the next index */
+				if (k + 1 >= num_indices)
+					return JSMN_ERROR_PART;
+				token = jsmn_alloc_token(parser, tokens, num_tokens);
+				if (token == NULL)
+					return JSMN_ERROR_NOMEM;
+				jsmn_fill_token(token, JSMN_STRING, pos + 1, indices[++k]);
+#ifdef JSMN_PARENT_LINKS
+				token->parent = parser->toksuper;
+#endif
+				if (parser->toksuper != -1)
+					tokens[parser->toksuper].size++;
+				break;
+			case ':':
+				parser->toksuper = parser->toknext - 1;
+				break;
+			case ',':
+				if (parser->toksuper != -1 && depth > 0 &&
+						tokens[parser->toksuper].type != JSMN_ARRAY &&
+						tokens[parser->toksuper].type != JSMN_OBJECT) {
+					parser->toksuper = stack[depth - 1];
+				}
+				break;
+			default: {
+				unsigned int end = pos;
+				for (; end < len; end++) {
+					char p = js[end];
+					if (p == '\t' || p == '\r' || p == '\n' || p == ' ' ||
+							p == ',' || p == ']' || p == '}' || p == ':' || p == '\0')
+						break;
+					if (p < 32 || p >= 127)
+						return JSMN_ERROR_INVAL;
+				}
+				token = jsmn_alloc_token(parser, tokens, num_tokens);
+				if (token == NULL)
+					return JSMN_ERROR_NOMEM;
+				jsmn_fill_token(token, JSMN_PRIMITIVE, pos, end);
+#ifdef JSMN_PARENT_LINKS
+				token->parent = parser->toksuper;
+#endif
+				if (parser->toksuper != -1)
+					tokens[parser->toksuper].size++;
+			} break;
+		}
+	}
+
+	parser->idxnext = num_indices;
+	if (depth > 0)
+		return JSMN_ERROR_PART;
+
+	parser->pos = len;
+	return parser->toknext;
+}
+
+/**
+ * Parses a JSON string exactly once, taking the index and token array from
+ * `a` and growing the tokens in place with Resize if the first guess was
+ * short. Needs common.h for struct Allocator. On success `*tokens_out` holds
+ * the returned number of tokens, trimmed to fit unless the allocator can't
+ * shrink it; nothing is left to free when `a` is an arena that gets reset.
+ */
+int jsmn_parse_alloc(jsmn_parser *parser, const char *js, size_t len,
+		struct Allocator a, jsmntok_t **tokens_out) {
+	unsigned int *indices;
+	jsmntok_t *tokens;
+	unsigned int cap;
+	int num_indices, r;
+
+	indices = Alloc(a, (len + 1) * sizeof(unsigned int));
+	if (indices == NULL)
+		return JSMN_ERROR_NOMEM;
+
+	num_indices = jsmn_index(js, len, indices);
+	if (num_indices < 0) {
+		Free(a, indices);
+		return num_indices;
+	}
+
+	/* Every token but a bare top-level primitive spends two indices */
+	cap = (unsigned int)num_indices / 2 + 16;
+	tokens = Alloc(a, cap * sizeof(jsmntok_t));
+	if (tokens == NULL) {
+		Free(a, indices);
+		return JSMN_ERROR_NOMEM;
+	}
+
+	for (;;) {
+		unsigned int grown;
+		jsmntok_t *resized;
+
+		r = jsmn_parse_index(parser, js, len, indices, num_indices, tokens, cap);
+		if (r != JSMN_ERROR_NOMEM || parser->toknext < cap)
+			break;
+
+		grown = cap * 2;
+		resized = Resize(a, tokens, cap * sizeof(jsmntok_t), grown * sizeof(jsmntok_t));
+		if (resized == NULL)
+			break;
+		tokens = resized;
+		cap = grown;
+	}
+
+	Free(a, indices);
+
+	if (r < 0) {
+		Free(a, tokens);
+		return r;
+	}
+
+	if ((unsigned int)r < cap && r > 0) {
+		/* Trimming is only to give memory back, keep the block if it fails */
+		jsmntok_t *trimmed = Resize(a, tokens, cap * sizeof(jsmntok_t), r * sizeof(jsmntok_t));
+		if (trimmed != NULL)
+			tokens = trimmed;
+	}
+
+	*tokens_out = tokens;
+	return r;
+}
+
+/**
+ * Streaming splitter for responses whose body is one top-level array.
+ * Chunks are fed as they arrive and every element is handed to the callback
+ * as soon as it closes, as a complete JSON value that can go straight into
+ * jsmn_parse_alloc. Elements that fit inside one chunk are passed without
+ * copying; only an element straddling chunks is buffered through the
+ * allocator. A callback returning a negative value stops the stream.
+ */
+typedef int (*jsmn_element_cb)(void *userdata, const char *js, size_t len);
+
+typedef struct {
+	struct Allocator allocator;
+	jsmn_element_cb callback;
+	void *userdata;
+
+	char *pending; /* partial element carried over from earlier chunks */
+	size_t pending_len;
+	size_t pending_cap;
+
+	int depth; /* 1 while between elements of the top-level array */
+	int in_element;
+	int in_string;
+	int escaped;
+	int done;
+	unsigned int count; /* elements emitted so far */
+} jsmn_stream;
+
+void jsmn_stream_init(jsmn_stream *stream, struct Allocator a,
+		jsmn_element_cb callback, void *userdata) {
+	memset(stream, 0, sizeof(*stream));
+	stream->allocator = a;
+	stream->callback = callback;
+	stream->userdata = userdata;
+}
+
+static int jsmn_stream_keep(jsmn_stream *stream, const char *js, size_t len) {
+	size_t need = stream->pending_len + len;
+	if (need > stream->pending_cap) {
+		size_t cap = stream->pending_cap ? stream->pending_cap : 4096;
+		char *grown;
+		while (cap < need) cap *= 2;
+		if (stream->pending)
+			grown = Resize(stream->allocator, stream->pending, stream->pending_cap, cap);
+		else
+			grown = Alloc(stream->allocator, cap);
+		if (grown == NULL)
+			return JSMN_ERROR_NOMEM;
+		stream->pending = grown;
+		stream->pending_cap = cap;
+	}
+	memcpy(stream->pending + stream->pending_len, js, len);
+	stream->pending_len += len;
+	return 0;
+}
+
+static int jsmn_stream_emit(jsmn_stream *stream, const char *js, size_t len) {
+	int r;
+	stream->in_element = 0;
+	stream->count++;
+	if (stream->pending_len > 0) {
+		r = jsmn_stream_keep(stream, js, len);
+		if (r < 0) return r;
+		r = stream->callback(stream->userdata, stream->pending, stream->pending_len);
+		stream->pending_len = 0;
+	} else {
+		r = stream->callback(stream->userdata, js, len);
+	}
+	return r < 0 ? r : 0;
+}
+
+/**
+ * Feeds the next chunk of the body. Returns 0, or a jsmnerr / the callback's
+ * negative return value.
+ */
+int jsmn_stream_feed(jsmn_stream *stream, const char *js, size_t len) {
+	size_t i, start = 0;
+	int r;
+
+	for (i = 0; i < len; i++) {
+		char c = js[i];
+
+		if (stream->in_string) {
+			if (stream->escaped)
+				stream->escaped = 0;
+			else if (c == '\\')
+				stream->escaped = 1;
+			else if (c == '\"') {
+				stream->in_string = 0;
+				if (stream->depth == 1) {
+					r = jsmn_stream_emit(stream, js + start, i + 1 - start);
+					if (r < 0) return r;
+				}
+			}
+			continue;
+		}
+
+		if (stream->in_element && stream->depth == 1) {
+			/* Inside a top-level primitive */
+			if (c == ',' || c == ']' || c == ' ' || c == '\t' ||
+					c == '\r' || c == '\n') {
+				r = jsmn_stream_emit(stream, js + start, i - start);
+				if (r < 0) return r;
+			} else {
+				continue;
+			}
+		}
+
+		switch (c) {
+			case '\t': case '\r': case '\n': case ' ':
+				break;
+			case '[': case '{':
+				if (stream->done)
+					return JSMN_ERROR_INVAL;
+				if (stream->depth == 0 && c == '{')
+					return JSMN_ERROR_INVAL;
+				if (stream->depth == 1 && !stream->in_element) {
+					stream->in_element = 1;
+					start = i;
+				}
+				stream->depth++;
+				break;
+			case ']': case '}':
+				if (stream->depth == 0)
+					return JSMN_ERROR_INVAL;
+				stream->depth--;
+				if (stream->depth == 0)
+					stream->done = 1;
+				else if (stream->depth == 1) {
+					r = jsmn_stream_emit(stream, js + start, i + 1 - start);
+					if (r < 0) return r;
+				}
+				break;
+			case '\"':
+				if (stream->depth == 0)
+					return JSMN_ERROR_INVAL;
+				if (stream->depth == 1 && !stream->in_element) {
+					stream->in_element = 1;
+					start = i;
+				}
+				stream->in_string = 1;
+				break;
+			case ',': case ':':
+				if (stream->depth == 0)
+					return JSMN_ERROR_INVAL;
+				break;
+			default:
+				if (stream->depth == 0)
+					return JSMN_ERROR_INVAL;
+				if (stream->depth == 1 && !stream->in_element) {
+					stream->in_element = 1;
+					start = i;
+				}
+				break;
+		}
+	}
+
+	if (stream->in_element) {
+		r = jsmn_stream_keep(stream, js + start, len - start);
+		if (r < 0) return r;
+	}
+
+	return 0;
+}
+
+/**
+ * Call once the body is complete. Frees the carry-over buffer and returns
+ * the element count, or JSMN_ERROR_PART if the array never closed.
+ */
+int jsmn_stream_finish(jsmn_stream *stream) {
+	Free(stream->allocator, stream->pending);
+	stream->pending = NULL;
+	stream->pending_len = stream->pending_cap = 0;
+
+	if (!stream->done)
+		return JSMN_ERROR_PART;
+	return (int)stream->count;
+}
+
+/**
+ * Finds the elements of a top-level array in a structural index. Element i
+ * covers indices[bounds[2*i]] up to but not including indices[bounds[2*i+1]],
+ * so each element can be handed to jsmn_parse_index on its own. `bounds`
+ * needs room for num_indices + 2 entries. Returns the element count.
+ */
+int jsmn_split_array(const char *js, const unsigned int *indices,
+		unsigned int num_indices, unsigned int *bounds) {
+	unsigned int k, count = 0;
+	int depth = 1, open = -1;
+
+	if (num_indices == 0 || js[indices[0]] != '[')
+		return JSMN_ERROR_INVAL;
+
+	for (k = 1; k < num_indices; k++) {
+		switch (js[indices[k]]) {
+			case '{': case '[':
+				if (depth == 1 && open < 0)
+					open = k;
+				depth++;
+				break;
+			case '}': case ']':
+				depth--;
+				if (depth == 0) {
+					/* A trailing primitive ends at the closing bracket */
+					if (open >= 0) {
+						bounds[2 * count] = open;
+						bounds[2 * count + 1] = k;
+						count++;
+					}
+					return count;
+				}
+				if (depth == 1) {
+					bounds[2 * count] = open;
+					bounds[2 * count + 1] = k + 1;
+					count++;
+					open = -1;
+				}
+				break;
+			case '\"':
+				if (depth == 1 && open < 0)
+					open = k;
+				k++;
+				if (depth == 1) {
+					bounds[2 * count] = open;
+					bounds[2 * count + 1] = k + 1;
+					count++;
+					open = -1;
+				}
+				break;
+			case ',':
+				if (depth == 1 && open >= 0) {
+					bounds[2 * count] = open;
+					bounds[2 * count + 1] = k;
+					count++;
+					open = -1;
+				}
+				break;
+			case ':':
+				break;
+			default:
+				if (depth == 1 && open < 0)
+					open = k;
+				break;
+		}
+	}
+
+	return JSMN_ERROR_PART;
+}
+
+/**
+ * Packed token tape.
+ *
+ * Every scalar is one 8 byte entry: its start offset and a word holding the
+ * type in the low 3 bits and the length above them. A container takes two
+ * entries, the opening one with its child count and a second one holding
+ * its end offset and the index of the entry after its last child, so
+ * skipping a subtree is still a single jump. Values that don't fit (offsets
+ * past 4 GB, lengths or child counts past 2^28) set JSMN_TAPE_WIDE and keep
+ * the index of a full-width record in `start` instead.
+ *
+ * Go through the jsmn_tape_* accessors rather than reading entries directly.
+ * As with jsmntok_t, an object's size counts its keys and the value of a key
+ * is the entry after it.
+ */
+typedef struct {
+	uint32_t start;
+	uint32_t info; /* type | JSMN_TAPE_WIDE | length or child count << 4 */
+} jsmntape_t;
+
+typedef struct {
+	uint64_t start;
+	uint64_t end;
+	uint64_t size;
+} jsmntape_wide_t;
+
+typedef struct {
+	jsmntape_t *entries;
+	unsigned int count;
+	jsmntape_wide_t *wide;
+	unsigned int wide_count;
+	unsigned int wide_cap;
+} jsmn_tape;
+
+#define JSMN_TAPE_TYPE_MASK 0x7u
+#define JSMN_TAPE_WIDE 0x8u
+#define JSMN_TAPE_PAYLOAD_SHIFT 4
+#define JSMN_TAPE_PAYLOAD_MAX ((1u << (32 - JSMN_TAPE_PAYLOAD_SHIFT)) - 1)
+
+static inline jsmntype_t jsmn_tape_type(const jsmn_tape *tape, unsigned int i) {
+	return (jsmntype_t)(tape->entries[i].info & JSMN_TAPE_TYPE_MASK);
+}
+
+static inline int jsmn_tape_is_container(const jsmn_tape *tape, unsigned int i) {
+	jsmntype_t type = jsmn_tape_type(tape, i);
+	return type == JSMN_OBJECT || type == JSMN_ARRAY;
+}
+
+static inline uint64_t jsmn_tape_start(const jsmn_tape *tape, unsigned int i) {
+	jsmntape_t e = tape->entries[i];
+	return (e.info & JSMN_TAPE_WIDE) ? tape->wide[e.start].start : e.start;
+}
+
+static inline uint64_t jsmn_tape_end(const jsmn_tape *tape, unsigned int i) {
+	jsmntape_t e = tape->entries[i];
+	if (e.info & JSMN_TAPE_WIDE)
+		return tape->wide[e.start].end;
+	if (jsmn_tape_is_container(tape, i))
+		return tape->entries[i + 1].start;
+	return (uint64_t)e.start + (e.info >> JSMN_TAPE_PAYLOAD_SHIFT);
+}
+
+static inline uint64_t jsmn_tape_size(const jsmn_tape *tape, unsigned int i) {
+	jsmntape_t e = tape->entries[i];
+	if (!jsmn_tape_is_container(tape, i))
+		return 0;
+	return (e.info & JSMN_TAPE_WIDE) ? tape->wide[e.start].size : e.info >> JSMN_TAPE_PAYLOAD_SHIFT;
+}
+
+/* Index of the entry after `i` and all of its children */
+static inline unsigned int jsmn_tape_next(const jsmn_tape *tape, unsigned int i) {
+	if (jsmn_tape_is_container(tape, i))
+		return tape->entries[i + 1].info;
+	return i + 1;
+}
+
+/* Index of the first child of the container at `i` */
+static inline unsigned int jsmn_tape_child(const jsmn_tape *tape, unsigned int i) {
+	return i + 2;
+}
+
+static int jsmn_tape_set(jsmn_tape *tape, struct Allocator a, unsigned int i,
+		jsmntype_t type, uint64_t start, uint64_t end, uint64_t payload) {
+	jsmntape_wide_t *wide;
+	int container = type == JSMN_OBJECT || type == JSMN_ARRAY;
+
+	if (start <= UINT32_MAX && end <= UINT32_MAX && payload <= JSMN_TAPE_PAYLOAD_MAX) {
+		tape->entries[i].start = (uint32_t)start;
+		tape->entries[i].info = type | ((uint32_t)payload << JSMN_TAPE_PAYLOAD_SHIFT);
+		if (container)
+			tape->entries[i + 1].start = (uint32_t)end;
+		return 0;
+	}
+
+	if (tape->wide_count == tape->wide_cap) {
+		unsigned int cap = tape->wide_cap ? tape->wide_cap * 2 : 16;
+		wide = tape->wide
+			? Resize(a, tape->wide, tape->wide_cap * sizeof(*wide), cap * sizeof(*wide))
+			: Alloc(a, cap * sizeof(*wide));
+		if (wide == NULL)
+			return JSMN_ERROR_NOMEM;
+		tape->wide = wide;
+		tape->wide_cap = cap;
+	}
+
+	wide = &tape->wide[tape->wide_count];
+	wide->start = start;
+	wide->end = end;
+	wide->size = container ? payload : 0;
+	tape->entries[i].start = tape->wide_count++;
+	tape->entries[i].info = type | JSMN_TAPE_WIDE;
+	return 0;
+}
+
+/**
+ * Builds a packed tape from a structural index built by jsmn_index64.
+ * Entries come from `a` and never outnumber the indices. Returns the entry
+ * count or a jsmnerr.
+ */
+int jsmn_tape_build(const char *js, size_t len, const uint64_t *indices,
+		unsigned int num_indices, struct Allocator a, jsmn_tape *tape) {
+	unsigned int stack[JSMN_MAX_DEPTH];
+	uint64_t starts[JSMN_MAX_DEPTH];
+	uint64_t sizes[JSMN_MAX_DEPTH];
+	int depth = 0, after_colon = 0, r = 0;
+	unsigned int k, n = 0;
+
+	memset(tape, 0, sizeof(*tape));
+	tape->entries = Alloc(a, (num_indices + 1) * sizeof(jsmntape_t));
+	if (tape->entries == NULL)
+		return JSMN_ERROR_NOMEM;
+
+	for (k = 0; k < num_indices && r == 0; k++) {
+		uint64_t pos = indices[k];
+		char c = js[pos];
+		int is_value = 0;
+
+		switch (c) {
+			case '{': case '[':
+				if (depth == JSMN_MAX_DEPTH) {
+					r = JSMN_ERROR_NOMEM;
+					break;
+				}
+				is_value = 1;
+				tape->entries[n].start = 0;
+				tape->entries[n].info = (c == '{' ? JSMN_OBJECT : JSMN_ARRAY);
+				tape->entries[n + 1].start = 0;
+				tape->entries[n + 1].info = 0;
+				break;
+			case '}': case ']': {
+				unsigned int open;
+				if (depth == 0) {
+					r = JSMN_ERROR_INVAL;
+					break;
+				}
+				open = stack[--depth];
+				if ((tape->entries[open].info & JSMN_TAPE_TYPE_MASK) != (c == '}' ? JSMN_OBJECT : JSMN_ARRAY)) {
+					r = JSMN_ERROR_INVAL;
+					break;
+				}
+				tape->entries[open + 1].info = n;
+				r = jsmn_tape_set(tape, a, open, (jsmntype_t)(tape->entries[open].info & JSMN_TAPE_TYPE_MASK),
+					starts[depth], pos + 1, sizes[depth]);
+				after_colon = 0;
+			} break;
+			case '\"':
+				if (k + 1 >= num_indices) {
+					r = JSMN_ERROR_PART;
+					break;
+				}
+				is_value = 1;
+				r = jsmn_tape_set(tape, a, n, JSMN_STRING, pos + 1, indices[k + 1], indices[k + 1] - (pos + 1));
+				k++;
+				break;
+			case ':':
+				after_colon = 1;
+				break;
+			case ',':
+				break;
+			default: {
+				uint64_t end = pos;
+				for (; end < len; end++) {
+					char p = js[end];
+					if (p == '\t' || p == '\r' || p == '\n' || p == ' ' ||
+							p == ',' || p == ']' || p == '}' || p == ':' || p == '\0')
+						break;
+					if (p < 32 || p >= 127) {
+						r = JSMN_ERROR_INVAL;
+						break;
+					}
+				}
+				if (r == 0) {
+					is_value = 1;
+					r = jsmn_tape_set(tape, a, n, JSMN_PRIMITIVE, pos, end, end - pos);
+				}
+			} break;
+		}
+
+		if (!is_value || r != 0)
+			continue;
+
+		/* Objects count keys, arrays count elements */
+		if (depth > 0 && (!after_colon ||
+				(tape->entries[stack[depth - 1]].info & JSMN_TAPE_TYPE_MASK) == JSMN_ARRAY))
+			sizes[depth - 1]++;
+		after_colon = 0;
+
+		if (c == '{' || c == '[') {
+			stack[depth] = n;
+			starts[depth] = pos;
+			sizes[depth] = 0;
+			depth++;
+			n += 2;
+		} else {
+			n += 1;
+		}
+	}
+
+	if (r == 0 && depth > 0)
+		r = JSMN_ERROR_PART;
+
+	if (r < 0) {
+		Free(a, tape->wide);
+		Free(a, tape->entries);
+		memset(tape, 0, sizeof(*tape));
+		return r;
+	}
+
+	if (n > 0 && n < num_indices + 1) {
+		/* Trimming is only to give memory back, keep the block if it fails */
+		jsmntape_t *trimmed = Resize(a, tape->entries, (num_indices + 1) * sizeof(jsmntape_t), n * sizeof(jsmntape_t));
+		if (trimmed != NULL)
+			tape->entries = trimmed;
+	}
+	tape->count = n;
+	return (int)n;
+}
+
+/**
+ * Checks that a tape read from somewhere untrusted is safe to walk from its
+ * first entry: it isn't empty, every entry has a known type, wide entries and next links stay inside the tape,
+ * containers hold exactly their child count and nest inside their parent,
+ * and every value lies within the `len` bytes of JSON. Returns 0 or
+ * JSMN_ERROR_INVAL.
+ */
+int jsmn_tape_check(const jsmn_tape *tape, uint64_t len) {
+	unsigned int ends[JSMN_MAX_DEPTH];
+	uint64_t left[JSMN_MAX_DEPTH];
+	int depth = 0;
+	unsigned int i = 0;
+
+	if (tape->count == 0)
+		return JSMN_ERROR_INVAL;
+
+	while (i < tape->count) {
+		jsmntape_t e = tape->entries[i];
+		jsmntype_t type = (jsmntype_t)(e.info & JSMN_TAPE_TYPE_MASK);
+		int container = type == JSMN_OBJECT || type == JSMN_ARRAY;
+		unsigned int next = i + 1;
+
+		while (depth > 0 && i == ends[depth - 1]) {
+			if (left[depth - 1] != 0)
+				return JSMN_ERROR_INVAL;
+			depth--;
+		}
+		if (depth > 0) {
+			if (left[depth - 1] == 0)
+				return JSMN_ERROR_INVAL;
+			left[depth - 1]--;
+		} else if (i != 0) {
+			return JSMN_ERROR_INVAL;
+		}
+
+		if (type < JSMN_OBJECT || type > JSMN_PRIMITIVE)
+			return JSMN_ERROR_INVAL;
+		if ((e.info & JSMN_TAPE_WIDE) && e.start >= tape->wide_count)
+			return JSMN_ERROR_INVAL;
+		if (container) {
+			if (i + 1 >= tape->count)
+				return JSMN_ERROR_INVAL;
+			next = tape->entries[i + 1].info;
+			if (next < i + 2 || next > tape->count || (depth > 0 && next > ends[depth - 1]))
+				return JSMN_ERROR_INVAL;
+		}
+		if (jsmn_tape_start(tape, i) > jsmn_tape_end(tape, i) || jsmn_tape_end(tape, i) > len)
+			return JSMN_ERROR_INVAL;
+
+		if (container) {
+			uint64_t size = jsmn_tape_size(tape, i);
+			if (depth == JSMN_MAX_DEPTH)
+				return JSMN_ERROR_INVAL;
+			ends[depth] = next;
+			left[depth] = type == JSMN_OBJECT ? 2 * size : size;
+			depth++;
+			i += 2;
+		} else {
+			i += 1;
+		}
+	}
+
+	/* Whatever is still open has to end with the tape */
+	for (; depth > 0; depth--) {
+		if (ends[depth - 1] != i || left[depth - 1] != 0)
+			return JSMN_ERROR_INVAL;
+	}
+	return 0;
 }
 
+void jsmn_tape_free(jsmn_tape *tape, struct Allocator a) {
+	Free(a, tape->wide);
+	Free(a, tape->entries);
+	memset(tape, 0, sizeof(*tape));
+}
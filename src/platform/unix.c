@@ -33,6 +33,10 @@ static void keyboard_callback(GLFWwindow *w, int key, int scancode, int action,
         input->keys[K_Left] = state;
     else if (key == GLFW_KEY_RIGHT)
         input->keys[K_Right] = state;
+    else if (key == GLFW_KEY_F1)
+        input->keys[K_F1] = state;
+    else if (key == GLFW_KEY_F2)
+        input->keys[K_F2] = state;
 }
 
 static void mouse_button_callback(GLFWwindow *w, int button, int action, int mods) {
@@ -54,10 +58,11 @@ static void glfw_err_handler(int code, const char *message) {
     printf("GLFW error: %s\n", message);
 }
 
-void *mapMemory(void *memStart, u64 size) {
-    void *mem = mmap(memStart, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-    if (mem == (void *)-1) {
-        printf("Failed to grab memory chunk: %s (%d)\n", strerror(errno), errno);
+// Reserves address space only, arenas commit it as they grow
+void *mapMemory(void *memStart, u64 size, u32 flags) {
+    void *mem = VMReserve(memStart, size, flags);
+    if (!mem) {
+        printf("Failed to reserve memory: %s (%d)\n", strerror(errno), errno);
         exit(1);
     }
 
@@ -88,28 +93,46 @@ int main() {
         return 3;
     }
 
+    struct State state = {0};
     struct Memory memory = {0};
     struct Input input = {0};
     struct Time time = {0};
 
+    DefaultState(&state);
+
     void *memStart = (void *)TB(1);
-    void *mem = mapMemory(memStart, MB(100));
-    memory.buffer = mem;
+    void *mem = mapMemory(memStart, MEMORY_RESERVE, 0);
+    if (!MemoryInit(&memory, mem, MEMORY_RESERVE)) {
+        printf("Failed to commit memory\n");
+        return 4;
+    }
 
+    // NOTE(Brett): room for far more vertices than a frame should need, only
+    // the first 64k of each are committed up front
     u32 maxVerts = 65536;
-    struct Vert *vertBuffer = mapMemory(NULL, maxVerts * sizeof(struct Vert));
-    struct TexturedVert *texturedVertBuffer = mapMemory(NULL, maxVerts * sizeof(struct TexturedVert));
+    u64 vertReserve = GB(1);
+    struct Arena vertArena, texturedVertArena;
+    ArenaInitReserved(&vertArena, mapMemory(NULL, vertReserve, VM_HUGE_PAGES), vertReserve, VM_HUGE_PAGES);
+    ArenaInitReserved(&texturedVertArena, mapMemory(NULL, vertReserve, VM_HUGE_PAGES), vertReserve, VM_HUGE_PAGES);
+    if (!ArenaCommit(&vertArena, maxVerts * sizeof(struct Vert)) ||
+            !ArenaCommit(&texturedVertArena, maxVerts * sizeof(struct TexturedVert))) {
+        printf("Failed to commit vertex buffers\n");
+        return 4;
+    }
 
     struct RenderCommands renderCommands = RenderCommandsInit(
-        KB(1),
-        memory.buffer,
-        maxVerts,
-        vertBuffer,
-        maxVerts,
-        texturedVertBuffer,
+        (u32)memory.commands.cap,
+        memory.commands.base,
+        (u32)(vertArena.cap / sizeof(struct Vert)),
+        (struct Vert *)vertArena.base,
+        (u32)(texturedVertArena.cap / sizeof(struct TexturedVert)),
+        (struct TexturedVert *)texturedVertArena.base,
         width,
         height
     );
+    renderCommands.commandArena = &memory.commands;
+    renderCommands.vertexArena = &vertArena;
+    renderCommands.texturedVertArena = &texturedVertArena;
 
     glfwSetWindowUserPointer(window, &input);
     glfwSetKeyCallback(window, keyboard_callback);
@@ -127,9 +150,10 @@ int main() {
         f64 now = glfwGetTime();
         deltaTime = now - lastTick;
 
-        Tick(&time, &input, &memory, &renderCommands, &running);
+        Tick(&state, &time, &input, &memory, &renderCommands, &running);
 
         OpenGLRenderCommands(&renderCommands);
+        RenderCommandsReset(&renderCommands);
 
         glfwSwapBuffers(window);
         glfwPollEvents();
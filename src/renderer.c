@@ -37,9 +37,32 @@ struct PushBufferResult {
     struct RenderEntryHeader *header;
 };
 
+// Commits more of `arena` so it holds `count` elements of `size` bytes.
+// Returns the new capacity, or `capacity` if it can't grow.
+INLINE
+u32 RenderBufferGrow(struct Arena *arena, u32 capacity, u64 size, u64 count) {
+    if (!arena || !ArenaCommit(arena, count * size))
+        return capacity;
+
+    u64 grown = arena->cap / size;
+    return grown > UINT32_MAX ? UINT32_MAX : (u32)grown;
+}
+
+INLINE
+void RenderCommandsReset(struct RenderCommands *commands) {
+    commands->commandIndex = 0;
+    commands->vertexCount = 0;
+    commands->texturedVertCount = 0;
+    commands->currentQuads = NULL;
+    commands->currentTexturedQuads = NULL;
+}
+
 INLINE
 struct PushBufferResult PushBuffer(struct RenderCommands *commands, u32 size) {
     struct PushBufferResult result = {0};
+    if ((u64)commands->commandIndex + size > commands->commandBufferSize)
+        commands->commandBufferSize = RenderBufferGrow(commands->commandArena, commands->commandBufferSize, 1, (u64)commands->commandIndex + size);
+
     if ((commands->commandIndex + size) <= commands->commandBufferSize) {
         void *index = commands->commandBuffer + commands->commandIndex;
         result.header = (struct RenderEntryHeader *)index;
@@ -90,7 +113,10 @@ struct RenderEntryQuads *GetQuads(struct RenderCommands *commands, enum QuadKind
     }
 
     struct RenderEntryQuads *quads = commands->currentQuads;
-    if (commands->vertexCount + (count * VERTS_PER_QUAD) > commands->vertexBufferSize) {
+    u64 needed = (u64)commands->vertexCount + (count * VERTS_PER_QUAD);
+    if (needed > commands->vertexBufferSize)
+        commands->vertexBufferSize = RenderBufferGrow(commands->vertexArena, commands->vertexBufferSize, sizeof(struct Vert), needed);
+    if (needed > commands->vertexBufferSize) {
         quads = NULL;
     }
 
@@ -108,7 +134,10 @@ struct RenderEntryTexturedQuads *GetTexturedQuads(struct RenderCommands *command
     }
 
     struct RenderEntryTexturedQuads *quads = commands->currentTexturedQuads;
-    if (commands->texturedVertCount + (count * VERTS_PER_QUAD) > commands->texturedVertBufferSize) {
+    u64 needed = (u64)commands->texturedVertCount + (count * VERTS_PER_QUAD);
+    if (needed > commands->texturedVertBufferSize)
+        commands->texturedVertBufferSize = RenderBufferGrow(commands->texturedVertArena, commands->texturedVertBufferSize, sizeof(struct TexturedVert), needed);
+    if (needed > commands->texturedVertBufferSize) {
         quads = NULL;
     }
 
@@ -0,0 +1,268 @@
+// Binary snapshot of decoded Trello models.
+//
+// Every model in TRELLO_MODELS gets a flat record type, struct <S>Record,
+// where strings are RelStr offsets into one shared string pool instead of
+// pointers. A snapshot is a header, one record array per model and the
+// pool, so it can be mapped and read in place with no fix-ups:
+//
+//     struct Snapshot snapshot;
+//     if (SnapshotOpen("boards.snap", false, &snapshot) == 0) {
+//         for (u32 i = 0; i < snapshot.BoardCount; i += 1) {
+//             struct Str name = SnapshotStr(&snapshot, snapshot.BoardRecords[i].name);
+//             ...
+//         }
+//         SnapshotClose(&snapshot);
+//     }
+//
+// Strings are unescaped when they are written, so nothing in the pool has
+// STR_ESCAPED set. Each record array stores its record size, which keeps a
+// snapshot from being read by a build with a different layout.
+//
+// Load failures are the same as TapeCacheOpen: -1 can't open or map the
+// file, -2 bad magic or version, -3 the sizes don't add up or a string is
+// outside the pool, -4 checksum mismatch.
+//
+// Requires common.h, decode.h, trello.h and cache.h.
+
+#define SNAPSHOT_MAGIC 0x50534E4Du // "MNSP"
+#define SNAPSHOT_VERSION 3
+
+#define SNAP_TYPE_Id     struct TrelloId
+#define SNAP_TYPE_String struct RelStr
+#define SNAP_TYPE_Number f64
+#define SNAP_TYPE_Bool   b32
+#define SNAP_TYPE_Timestamp u64
+
+#define DECLARE_RECORD_FIELD(S, type, name) SNAP_TYPE_##type name;
+#define DECLARE_RECORD(S, FIELDS) struct S##Record { FIELDS(DECLARE_RECORD_FIELD, S) };
+TRELLO_MODELS(DECLARE_RECORD)
+#undef DECLARE_RECORD
+#undef DECLARE_RECORD_FIELD
+
+enum SnapshotModel {
+#define DECLARE_MODEL_ID(S, FIELDS) SnapshotModel_##S,
+    TRELLO_MODELS(DECLARE_MODEL_ID)
+#undef DECLARE_MODEL_ID
+    SnapshotModel_Count
+};
+
+struct SnapshotSection {
+    u64 offset;
+    u32 count;
+    u32 recordSize;
+};
+
+struct SnapshotHeader {
+    u32 magic;
+    u32 version;
+    u64 checksum; // HashBytes of everything after the header
+    u64 fileSize;
+    struct SnapshotSection models[SnapshotModel_Count];
+    struct SnapshotSection strings; // count is the pool size in bytes
+};
+
+// Models to write. Counts of zero are fine.
+struct SnapshotModels {
+#define DECLARE_MODEL_ARRAY(S, FIELDS) const struct S *S##Items; u32 S##Count;
+    TRELLO_MODELS(DECLARE_MODEL_ARRAY)
+#undef DECLARE_MODEL_ARRAY
+};
+
+// A mapped snapshot. The record arrays point into the mapping.
+struct Snapshot {
+    void *base;
+    u64 size;
+    const char *strings;
+    u32 stringsSize;
+#define DECLARE_MODEL_RECORDS(S, FIELDS) const struct S##Record *S##Records; u32 S##Count;
+    TRELLO_MODELS(DECLARE_MODEL_RECORDS)
+#undef DECLARE_MODEL_RECORDS
+};
+
+INLINE struct Str SnapshotStr(const struct Snapshot *snapshot, struct RelStr s) {
+    return RelStrGet(snapshot->strings, s);
+}
+
+INLINE u64 SnapshotAlign(u64 offset) {
+    return (offset + 7) & ~7ull;
+}
+
+struct SnapshotPool {
+    u8 *data;
+    u64 size;
+};
+
+INLINE void SnapshotConvert_String(struct SnapshotPool *pool, struct RelStr *out, const struct Str *in) {
+    u8 *at = pool->data + pool->size;
+    u32 len = in->len;
+    if (in->flags & STR_ESCAPED) {
+        i64 unescaped = JsonUnescape((const u8 *)in->data, in->len, at);
+        len = unescaped < 0 ? 0 : (u32)unescaped;
+    } else if (in->len) {
+        memcpy(at, in->data, in->len);
+    }
+    *out = RelStrMake(pool->data, StrMake((const char *)at, len, 0));
+    pool->size += len;
+}
+
+INLINE void SnapshotConvert_Id(struct SnapshotPool *pool, struct TrelloId *out, const struct TrelloId *in) { *out = *in; }
+INLINE void SnapshotConvert_Number(struct SnapshotPool *pool, f64 *out, const f64 *in) { *out = *in; }
+INLINE void SnapshotConvert_Bool(struct SnapshotPool *pool, b32 *out, const b32 *in) { *out = *in; }
+INLINE void SnapshotConvert_Timestamp(struct SnapshotPool *pool, u64 *out, const u64 *in) { *out = *in; }
+
+// Whether a field read from a mapped record stays inside the string pool
+INLINE b32 SnapshotValid_String(const struct RelStr *in, u64 stringsSize) {
+    return !in->escaped && (u64)in->offset + in->len <= stringsSize;
+}
+
+INLINE b32 SnapshotValid_Id(const struct TrelloId *in, u64 stringsSize) { return true; }
+INLINE b32 SnapshotValid_Number(const f64 *in, u64 stringsSize) { return true; }
+INLINE b32 SnapshotValid_Bool(const b32 *in, u64 stringsSize) { return true; }
+INLINE b32 SnapshotValid_Timestamp(const u64 *in, u64 stringsSize) { return true; }
+
+INLINE u64 SnapshotStringBytes_String(const struct Str *in) { return in->len; }
+INLINE u64 SnapshotStringBytes_Id(const struct TrelloId *in) { return 0; }
+INLINE u64 SnapshotStringBytes_Number(const f64 *in) { return 0; }
+INLINE u64 SnapshotStringBytes_Bool(const b32 *in) { return 0; }
+INLINE u64 SnapshotStringBytes_Timestamp(const u64 *in) { return 0; }
+
+// Lays out the header for `models`. The string section is sized for the
+// worst case here (unescaping only ever shrinks a string) and trimmed once
+// the pool is written.
+void SnapshotLayout(struct SnapshotHeader *header, const struct SnapshotModels *models) {
+    memset(header, 0, sizeof(*header));
+    header->magic = SNAPSHOT_MAGIC;
+    header->version = SNAPSHOT_VERSION;
+
+    u64 offset = SnapshotAlign(sizeof(*header));
+    u64 stringBytes = 0;
+
+#define STRING_BYTES_FIELD(S, type, name) stringBytes += SnapshotStringBytes_##type(&item->name);
+#define LAYOUT_MODEL(S, FIELDS) \
+    header->models[SnapshotModel_##S].offset = offset; \
+    header->models[SnapshotModel_##S].count = models->S##Count; \
+    header->models[SnapshotModel_##S].recordSize = sizeof(struct S##Record); \
+    offset = SnapshotAlign(offset + (u64)models->S##Count * sizeof(struct S##Record)); \
+    for (u32 i = 0; i < models->S##Count; i += 1) { \
+        const struct S *item = &models->S##Items[i]; \
+        FIELDS(STRING_BYTES_FIELD, S) \
+    }
+    TRELLO_MODELS(LAYOUT_MODEL)
+#undef LAYOUT_MODEL
+#undef STRING_BYTES_FIELD
+
+    header->strings.offset = offset;
+    header->strings.count = (u32)stringBytes;
+    header->strings.recordSize = 1;
+    header->fileSize = offset + stringBytes;
+}
+
+// Writes `models` to `path` through FileWriteAtomic. Returns 0 on success.
+int SnapshotWrite(const char *path, const struct SnapshotModels *models) {
+    struct SnapshotHeader header;
+    SnapshotLayout(&header, models);
+
+    u8 *image = calloc(1, header.fileSize);
+    if (!image)
+        return -1;
+
+    struct SnapshotPool pool;
+    pool.data = image + header.strings.offset;
+    pool.size = 0;
+
+#define CONVERT_FIELD(S, type, name) SnapshotConvert_##type(&pool, &record->name, &item->name);
+#define CONVERT_MODEL(S, FIELDS) { \
+        struct S##Record *records = (struct S##Record *)(image + header.models[SnapshotModel_##S].offset); \
+        for (u32 i = 0; i < models->S##Count; i += 1) { \
+            const struct S *item = &models->S##Items[i]; \
+            struct S##Record *record = &records[i]; \
+            FIELDS(CONVERT_FIELD, S) \
+        } \
+    }
+    TRELLO_MODELS(CONVERT_MODEL)
+#undef CONVERT_MODEL
+#undef CONVERT_FIELD
+
+    header.strings.count = (u32)pool.size;
+    header.fileSize = header.strings.offset + pool.size;
+    header.checksum = HashBytes(image + sizeof(header), header.fileSize - sizeof(header), SNAPSHOT_MAGIC);
+    memcpy(image, &header, sizeof(header));
+
+    int result = FileWriteAtomic(path, image, header.fileSize);
+    free(image);
+    return result;
+}
+
+// Maps a snapshot written by SnapshotWrite. Every string in the records is
+// checked against the pool, which reads the record arrays once. `verify`
+// also checks the checksum, which touches every page of the file.
+int SnapshotOpen(const char *path, b32 verify, struct Snapshot *snapshot) {
+    memset(snapshot, 0, sizeof(*snapshot));
+
+    u64 size;
+    void *base = FileMap(path, sizeof(struct SnapshotHeader), &size);
+    if (!base)
+        return -1;
+
+    const struct SnapshotHeader *header = base;
+    int result = 0;
+
+    if (header->magic != SNAPSHOT_MAGIC || header->version != SNAPSHOT_VERSION) {
+        result = -2;
+    } else if (header->fileSize != size || header->strings.offset < sizeof(*header) ||
+            header->strings.offset + header->strings.count != size) {
+        result = -3;
+    } else {
+#define CHECK_MODEL(S, FIELDS) { \
+            const struct SnapshotSection *section = &header->models[SnapshotModel_##S]; \
+            if (section->recordSize != sizeof(struct S##Record) || (section->offset & 7) || \
+                    section->offset < sizeof(*header) || \
+                    section->offset + (u64)section->count * section->recordSize > header->strings.offset) \
+                result = -3; \
+        }
+        TRELLO_MODELS(CHECK_MODEL)
+#undef CHECK_MODEL
+    }
+
+    if (result == 0) {
+#define CHECK_FIELD(S, type, name) valid &= SnapshotValid_##type(&record->name, header->strings.count);
+#define CHECK_RECORDS(S, FIELDS) { \
+            const struct S##Record *records = (const struct S##Record *)((u8 *)base + header->models[SnapshotModel_##S].offset); \
+            b32 valid = true; \
+            for (u32 i = 0; i < header->models[SnapshotModel_##S].count; i += 1) { \
+                const struct S##Record *record = &records[i]; \
+                FIELDS(CHECK_FIELD, S) \
+            } \
+            if (!valid) \
+                result = -3; \
+        }
+        TRELLO_MODELS(CHECK_RECORDS)
+#undef CHECK_RECORDS
+#undef CHECK_FIELD
+    }
+
+    if (result == 0 && verify && HashBytes((u8 *)base + sizeof(*header), size - sizeof(*header), SNAPSHOT_MAGIC) != header->checksum)
+        result = -4;
+
+    if (result < 0) {
+        munmap(base, size);
+        return result;
+    }
+
+    snapshot->base = base;
+    snapshot->size = size;
+    snapshot->strings = (const char *)base + header->strings.offset;
+    snapshot->stringsSize = header->strings.count;
+#define MAP_MODEL(S, FIELDS) \
+    snapshot->S##Records = (const struct S##Record *)((u8 *)base + header->models[SnapshotModel_##S].offset); \
+    snapshot->S##Count = header->models[SnapshotModel_##S].count;
+    TRELLO_MODELS(MAP_MODEL)
+#undef MAP_MODEL
+    return 0;
+}
+
+void SnapshotClose(struct Snapshot *snapshot) {
+    if (snapshot->base)
+        munmap(snapshot->base, snapshot->size);
+    memset(snapshot, 0, sizeof(*snapshot));
+}
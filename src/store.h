@@ -0,0 +1,518 @@
+// Columnar store for Trello models.
+//
+// Each model is a table of parallel arrays, one per column, so layout,
+// filtering and sorting walk tight arrays of the one or two columns they
+// need. Rows are addressed by u32 index. Every string is interned once in
+// the store's StringTable and columns hold its u32 handle, so repeated
+// label and member names are stored once. IDs are kept as 12 byte
+// struct TrelloId and each table has an IdIndex mapping them back to its
+// rows, so an ID only ever resolves to a row of the table it was looked up
+// in.
+//
+// References between models (a list's board, a card's list) are resolved
+// to row indices with one IdIndex probe as rows are added, so add boards
+// first, then labels and lists, then cards. A reference that can't be
+// resolved is STORE_NONE.
+//
+// Out of memory, StoreAdd* return STORE_NONE without adding the row and a
+// string that can't be interned reads back as the empty string.
+//
+// Rows and string handles are 32 bits and don't depend on where the
+// columns are allocated, so they already do for the store what RelPtr does
+// for structs that point at each other inside Memory.
+//
+// Cards keep their labels as a bitset of label slots, the position of the
+// label among its board's labels, so a board can have up to 64 labels that
+// cards can filter on. Boards count their labels so a slot is O(1).
+//
+// Requires common.h, decode.h and trello.h.
+
+#define STORE_NONE 0xFFFFFFFFu
+
+// Interned strings. Handle 0 is always the empty string.
+struct StringTable {
+    struct Allocator allocator;
+    char *bytes;
+    u32 bytesLen, bytesCap;
+    u32 *offsets; // string i is bytes[offsets[i], offsets[i+1])
+    u32 *hashes;
+    u32 count, cap;
+    u32 *slots; // handle + 1, 0 is empty
+    u32 slotCap;
+};
+
+INLINE u32 StringTableHash(const char *data, u32 len) {
+    return (u32)HashBytes(data, len, 0);
+}
+
+// STORE_NONE, from an intern that ran out of memory, is the empty string
+INLINE struct Str StringGet(struct StringTable *t, u32 handle) {
+    if (handle >= t->count)
+        return StrMake(t->bytes, 0, 0);
+    return StrMake(t->bytes + t->offsets[handle], t->offsets[handle + 1] - t->offsets[handle], 0);
+}
+
+// Keeps the old slots if the new ones can't be allocated
+b32 StringTableRehash(struct StringTable *t, u32 slotCap) {
+    u32 *slots = Alloc(t->allocator, sizeof(u32) * slotCap);
+    if (!slots)
+        return false;
+    if (t->slots)
+        Free(t->allocator, t->slots);
+    t->slots = slots;
+    memset(t->slots, 0, sizeof(u32) * slotCap);
+    t->slotCap = slotCap;
+
+    for (u32 handle = 0; handle < t->count; handle += 1) {
+        u32 slot = t->hashes[handle] & (slotCap - 1);
+        while (t->slots[slot])
+            slot = (slot + 1) & (slotCap - 1);
+        t->slots[slot] = handle + 1;
+    }
+    return true;
+}
+
+// Returns the handle of `len` bytes at `data`, or STORE_NONE if they were
+// never interned
+u32 StringFind(struct StringTable *t, const char *data, u32 len) {
+    u32 hash = StringTableHash(data, len);
+    u32 slot = hash & (t->slotCap - 1);
+    for (u32 h; (h = t->slots[slot]); slot = (slot + 1) & (t->slotCap - 1)) {
+        h -= 1;
+        if (t->hashes[h] == hash && t->offsets[h + 1] - t->offsets[h] == len &&
+                (len == 0 || memcmp(t->bytes + t->offsets[h], data, len) == 0))
+            return h;
+    }
+    return STORE_NONE;
+}
+
+// Returns the handle of `len` bytes at `data`, adding them if they're new,
+// or STORE_NONE if there's no memory to add them
+u32 StringIntern(struct StringTable *t, const char *data, u32 len) {
+    u32 found = StringFind(t, data, len);
+    if (found != STORE_NONE)
+        return found;
+
+    if (t->bytesLen + len > t->bytesCap) {
+        u32 cap = t->bytesCap * 2;
+        while (cap < t->bytesLen + len)
+            cap *= 2;
+        char *bytes = Resize(t->allocator, t->bytes, t->bytesCap, cap);
+        if (!bytes)
+            return STORE_NONE;
+        t->bytes = bytes;
+        t->bytesCap = cap;
+    }
+
+    if (t->count + 1 == t->cap) {
+        u32 cap = t->cap * 2;
+        u32 *offsets = Resize(t->allocator, t->offsets, sizeof(u32) * t->cap, sizeof(u32) * cap);
+        if (!offsets)
+            return STORE_NONE;
+        t->offsets = offsets;
+        u32 *hashes = Resize(t->allocator, t->hashes, sizeof(u32) * t->cap, sizeof(u32) * cap);
+        if (!hashes)
+            return STORE_NONE;
+        t->hashes = hashes;
+        t->cap = cap;
+    }
+
+    // A full rehash that fails can go on with the old slots while one is
+    // still free
+    if ((t->count + 1) * 2 > t->slotCap && !StringTableRehash(t, t->slotCap * 2) && t->count + 1 >= t->slotCap)
+        return STORE_NONE;
+
+    u32 hash = StringTableHash(data, len);
+    u32 handle = t->count++;
+    if (len)
+        memcpy(t->bytes + t->bytesLen, data, len);
+    t->bytesLen += len;
+    t->offsets[handle + 1] = t->bytesLen;
+    t->hashes[handle] = hash;
+
+    // Rehashed above to keep the load under a half, probes stay short
+    u32 slot = hash & (t->slotCap - 1);
+    while (t->slots[slot])
+        slot = (slot + 1) & (t->slotCap - 1);
+    t->slots[slot] = handle + 1;
+    return handle;
+}
+
+void StringTableFree(struct StringTable *t) {
+    if (t->bytes) Free(t->allocator, t->bytes);
+    if (t->offsets) Free(t->allocator, t->offsets);
+    if (t->hashes) Free(t->allocator, t->hashes);
+    if (t->slots) Free(t->allocator, t->slots);
+    memset(t, 0, sizeof(*t));
+}
+
+// Returns false, with nothing left to free, if it runs out of memory
+b32 StringTableInit(struct StringTable *t, struct Allocator a) {
+    memset(t, 0, sizeof(*t));
+    t->allocator = a;
+    t->bytesCap = KB(4);
+    t->bytes = Alloc(a, t->bytesCap);
+    t->cap = 256;
+    t->offsets = Alloc(a, sizeof(u32) * t->cap);
+    t->hashes = Alloc(a, sizeof(u32) * t->cap);
+    if (!t->bytes || !t->offsets || !t->hashes || !StringTableRehash(t, 512)) {
+        StringTableFree(t);
+        return false;
+    }
+    t->offsets[0] = 0;
+    StringIntern(t, "", 0);
+    return true;
+}
+
+// Open addressing from ID to row, linear probing at under half load. Empty
+// slots have a row of STORE_NONE.
+struct IdIndex {
+    struct Allocator allocator;
+    struct TrelloId *keys;
+    u32 *rows;
+    u32 count, cap; // cap is a power of two
+};
+
+void IdIndexFree(struct IdIndex *index) {
+    if (index->keys) Free(index->allocator, index->keys);
+    if (index->rows) Free(index->allocator, index->rows);
+    memset(index, 0, sizeof(*index));
+}
+
+// Returns false, with nothing left to free, if it runs out of memory
+b32 IdIndexInit(struct IdIndex *index, struct Allocator a, u32 cap) {
+    index->allocator = a;
+    index->keys = Alloc(a, sizeof(struct TrelloId) * cap);
+    index->rows = Alloc(a, sizeof(u32) * cap);
+    index->count = 0;
+    index->cap = cap;
+    if (!index->keys || !index->rows) {
+        IdIndexFree(index);
+        return false;
+    }
+    memset(index->rows, 0xFF, sizeof(u32) * cap);
+    return true;
+}
+
+INLINE u32 IdIndexSlot(struct IdIndex *index, struct TrelloId id) {
+    u32 mask = index->cap - 1;
+    u32 slot = TrelloIdHash(id) & mask;
+    while (index->rows[slot] != STORE_NONE && !TrelloIdEq(index->keys[slot], id))
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+// Row of `id`, or STORE_NONE
+INLINE u32 IdIndexGet(struct IdIndex *index, struct TrelloId id) {
+    return index->rows[IdIndexSlot(index, id)];
+}
+
+// Returns false if the index couldn't grow and is out of room. It goes on
+// past half load when growing fails, as long as a slot stays empty.
+b32 IdIndexSet(struct IdIndex *index, struct TrelloId id, u32 row) {
+    if ((index->count + 1) * 2 > index->cap) {
+        struct IdIndex old = *index;
+        if (IdIndexInit(index, old.allocator, old.cap * 2)) {
+            for (u32 i = 0; i < old.cap; i += 1) {
+                if (old.rows[i] != STORE_NONE)
+                    IdIndexSet(index, old.keys[i], old.rows[i]);
+            }
+            IdIndexFree(&old);
+        } else {
+            *index = old;
+            if (index->count + 1 >= index->cap && IdIndexGet(index, id) == STORE_NONE)
+                return false;
+        }
+    }
+
+    u32 slot = IdIndexSlot(index, id);
+    if (index->rows[slot] == STORE_NONE) {
+        index->keys[slot] = id;
+        index->count += 1;
+    }
+    index->rows[slot] = row;
+    return true;
+}
+
+#define BOARD_COLUMNS(X) \
+    X(struct TrelloId, id) \
+    X(u32, name) \
+    X(u64, dateLastActivity) \
+    X(u32, labelCount) \
+    X(u8,  closed)
+
+#define LIST_COLUMNS(X) \
+    X(struct TrelloId, id) \
+    X(u32, name) \
+    X(u32, board) \
+    X(f64, pos) \
+    X(u8,  closed)
+
+#define CARD_COLUMNS(X) \
+    X(struct TrelloId, id) \
+    X(u32, name) \
+    X(u32, board) \
+    X(u32, list) \
+    X(f64, pos) \
+    X(u64, labels) \
+    X(u64, dateLastActivity) \
+    X(u8,  closed)
+
+#define LABEL_COLUMNS(X) \
+    X(struct TrelloId, id) \
+    X(u32, name) \
+    X(u32, color) \
+    X(u32, board) \
+    X(u8,  slot)
+
+#define MEMBER_COLUMNS(X) \
+    X(struct TrelloId, id) \
+    X(u32, username) \
+    X(u32, fullName) \
+    X(u32, initials)
+
+#define STORE_TABLES(X) \
+    X(Board,  boards,  BOARD_COLUMNS) \
+    X(List,   lists,   LIST_COLUMNS) \
+    X(Card,   cards,   CARD_COLUMNS) \
+    X(Label,  labels,  LABEL_COLUMNS) \
+    X(Member, members, MEMBER_COLUMNS)
+
+#define DECLARE_COLUMN(type, name) type *name;
+#define DECLARE_TABLE(S, table, COLUMNS) \
+    struct S##Table { \
+        u32 count, cap; \
+        struct IdIndex ids; /* id -> row in this table */ \
+        COLUMNS(DECLARE_COLUMN) \
+    };
+STORE_TABLES(DECLARE_TABLE)
+#undef DECLARE_TABLE
+#undef DECLARE_COLUMN
+
+struct Store {
+    struct Allocator allocator;
+    struct StringTable strings;
+#define DECLARE_STORE_TABLE(S, table, COLUMNS) struct S##Table table;
+    STORE_TABLES(DECLARE_STORE_TABLE)
+#undef DECLARE_STORE_TABLE
+};
+
+#define COLUMN_BYTES(type, name) + sizeof(type)
+#define DEFINE_TABLE_FUNCS(S, table, COLUMNS) \
+    INLINE u32 S##RowBytes() { return 0 COLUMNS(COLUMN_BYTES); } \
+    \
+    /* A column that grew before another failed keeps its bigger block, */ \
+    /* cap only moves once they all have */ \
+    u32 S##TableAppend(struct Allocator a, struct S##Table *t) { \
+        if (t->count == t->cap) { \
+            u32 cap = t->cap ? t->cap * 2 : 64; \
+            COLUMNS(GROW_COLUMN) \
+            t->cap = cap; \
+        } \
+        return t->count++; \
+    } \
+    \
+    void S##TableFree(struct Allocator a, struct S##Table *t) { \
+        COLUMNS(FREE_COLUMN) \
+        IdIndexFree(&t->ids); \
+        memset(t, 0, sizeof(*t)); \
+    }
+#define GROW_COLUMN(type, name) { \
+        type *grown = t->name ? Resize(a, t->name, sizeof(type) * t->cap, sizeof(type) * cap) : Alloc(a, sizeof(type) * cap); \
+        if (!grown) \
+            return STORE_NONE; \
+        t->name = grown; \
+    }
+#define FREE_COLUMN(type, name) if (t->name) Free(a, t->name);
+STORE_TABLES(DEFINE_TABLE_FUNCS)
+#undef FREE_COLUMN
+#undef GROW_COLUMN
+#undef DEFINE_TABLE_FUNCS
+#undef COLUMN_BYTES
+
+void StoreFree(struct Store *store) {
+    struct Allocator a = store->allocator;
+#define FREE_TABLE(S, table, COLUMNS) S##TableFree(a, &store->table);
+    STORE_TABLES(FREE_TABLE)
+#undef FREE_TABLE
+    StringTableFree(&store->strings);
+}
+
+// Returns false, with nothing left to free, if it runs out of memory
+b32 StoreInit(struct Store *store, struct Allocator a) {
+    memset(store, 0, sizeof(*store));
+    store->allocator = a;
+    b32 ok = StringTableInit(&store->strings, a);
+#define INIT_TABLE(S, table, COLUMNS) ok = ok && IdIndexInit(&store->table.ids, a, 64);
+    STORE_TABLES(INIT_TABLE)
+#undef INIT_TABLE
+    if (!ok)
+        StoreFree(store);
+    return ok;
+}
+
+// Interns a decoded string, unescaping it first if it needs it
+u32 StoreIntern(struct Store *store, struct Str s) {
+    if (!(s.flags & STR_ESCAPED))
+        return StringIntern(&store->strings, s.data, s.len);
+
+    struct Str unescaped = StrUnescape(store->allocator, s);
+    u32 handle = StringIntern(&store->strings, unescaped.data, unescaped.len);
+    if (unescaped.data != s.data)
+        Free(store->allocator, (void *)unescaped.data);
+    return handle;
+}
+
+INLINE struct Str StoreStr(struct Store *store, u32 handle) {
+    return StringGet(&store->strings, handle);
+}
+
+// Row of the model with `id` in `table` (boards, lists, ...), or
+// STORE_NONE if `id` isn't one of that table's
+#define StoreFind(store, table, id) IdIndexGet(&(store)->table.ids, (id))
+
+// Appends a row to `table` and indexes its ID, or returns STORE_NONE
+#define STORE_APPEND(S, store, table, _id) ({ \
+    u32 _row = S##TableAppend((store)->allocator, &(store)->table); \
+    if (_row != STORE_NONE && !StoreIndex(&(store)->table.ids, (_id), _row)) { \
+        (store)->table.count -= 1; \
+        _row = STORE_NONE; \
+    } \
+    _row; \
+})
+
+INLINE b32 StoreIndex(struct IdIndex *ids, struct TrelloId id, u32 row) {
+    return TrelloIdIsZero(id) || IdIndexSet(ids, id, row);
+}
+
+u32 StoreAddBoard(struct Store *store, const struct Board *board) {
+    struct BoardTable *t = &store->boards;
+    u32 row = STORE_APPEND(Board, store, boards, board->id);
+    if (row == STORE_NONE)
+        return STORE_NONE;
+    t->id[row] = board->id;
+    t->name[row] = StoreIntern(store, board->name);
+    t->dateLastActivity[row] = board->dateLastActivity;
+    t->labelCount[row] = 0;
+    t->closed[row] = board->closed != 0;
+    return row;
+}
+
+u32 StoreAddList(struct Store *store, const struct List *list) {
+    struct ListTable *t = &store->lists;
+    u32 row = STORE_APPEND(List, store, lists, list->id);
+    if (row == STORE_NONE)
+        return STORE_NONE;
+    t->id[row] = list->id;
+    t->name[row] = StoreIntern(store, list->name);
+    t->board[row] = StoreFind(store, boards, list->idBoard);
+    t->pos[row] = list->pos;
+    t->closed[row] = list->closed != 0;
+    return row;
+}
+
+u32 StoreAddLabel(struct Store *store, const struct Label *label) {
+    struct LabelTable *t = &store->labels;
+    u32 row = STORE_APPEND(Label, store, labels, label->id);
+    if (row == STORE_NONE)
+        return STORE_NONE;
+    u32 board = StoreFind(store, boards, label->idBoard);
+
+    // Slots are handed out per board in the order labels arrive. Labels
+    // without a board have nothing to filter against and get no slot.
+    u32 slot = 0xFF;
+    if (board < store->boards.count)
+        slot = store->boards.labelCount[board]++;
+
+    t->id[row] = label->id;
+    t->name[row] = StoreIntern(store, label->name);
+    t->color[row] = StoreIntern(store, label->color);
+    t->board[row] = board;
+    t->slot[row] = slot < 64 ? (u8)slot : 0xFF;
+    return row;
+}
+
+u32 StoreAddCard(struct Store *store, const struct Card *card) {
+    struct CardTable *t = &store->cards;
+    u32 row = STORE_APPEND(Card, store, cards, card->id);
+    if (row == STORE_NONE)
+        return STORE_NONE;
+    t->id[row] = card->id;
+    t->name[row] = StoreIntern(store, card->name);
+    t->board[row] = StoreFind(store, boards, card->idBoard);
+    t->list[row] = StoreFind(store, lists, card->idList);
+    t->pos[row] = card->pos;
+    t->labels[row] = 0;
+    t->dateLastActivity[row] = card->dateLastActivity;
+    t->closed[row] = card->closed != 0;
+    return row;
+}
+
+u32 StoreAddMember(struct Store *store, const struct Member *member) {
+    struct MemberTable *t = &store->members;
+    u32 row = STORE_APPEND(Member, store, members, member->id);
+    if (row == STORE_NONE)
+        return STORE_NONE;
+    t->id[row] = member->id;
+    t->username[row] = StoreIntern(store, member->username);
+    t->fullName[row] = StoreIntern(store, member->fullName);
+    t->initials[row] = StoreIntern(store, member->initials);
+    return row;
+}
+
+// Tags `card` with the label with `labelId`. Returns false if the label
+// isn't known or its board is out of slots.
+b32 StoreCardAddLabel(struct Store *store, u32 card, struct TrelloId labelId) {
+    u32 label = StoreFind(store, labels, labelId);
+    if (label == STORE_NONE || store->labels.slot[label] == 0xFF)
+        return false;
+    store->cards.labels[card] |= 1ull << store->labels.slot[label];
+    return true;
+}
+
+struct StoreSortKey {
+    f64 pos;
+    u32 row;
+};
+
+// By position, then by row so equal positions keep the order they were
+// added in
+int StoreSortKeyCompare(const void *lhs, const void *rhs) {
+    const struct StoreSortKey *a = lhs, *b = rhs;
+    if (a->pos != b->pos)
+        return a->pos < b->pos ? -1 : 1;
+    return a->row < b->row ? -1 : a->row > b->row;
+}
+
+// Replaces what's in `rows` with the open cards of `list`, in `pos` order.
+// Returns how many there were, or STORE_NONE if `rows` or the sort ran out
+// of memory.
+u32 StoreCardsInList(struct Store *store, u32 list, Array(u32) *rows) {
+    struct CardTable *t = &store->cards;
+    ArrayClear(*rows);
+    for (u32 i = 0; i < t->count; i += 1) {
+        if (t->list[i] == list && !t->closed[i])
+            ArrayPush(*rows, i);
+    }
+    if (ArrayFailed(*rows))
+        return STORE_NONE;
+
+    u32 *sorted = *rows;
+    u32 count = (u32)ArrayLen(sorted);
+    if (count < 2)
+        return count;
+
+    // Sorted as keys so the comparison doesn't need the store
+    struct StoreSortKey *keys = Alloc(store->allocator, sizeof(struct StoreSortKey) * count);
+    if (!keys)
+        return STORE_NONE;
+    for (u32 i = 0; i < count; i += 1) {
+        keys[i].pos = t->pos[sorted[i]];
+        keys[i].row = sorted[i];
+    }
+    qsort(keys, count, sizeof(struct StoreSortKey), StoreSortKeyCompare);
+    for (u32 i = 0; i < count; i += 1)
+        sorted[i] = keys[i].row;
+    Free(store->allocator, keys);
+    return count;
+}
@@ -0,0 +1,560 @@
+// Trello model types and their JSON decoders.
+//
+// Each model is described once as an X-macro field list. The struct, its
+// schema table and a typed Decode<Model> function are all generated from
+// that list, so adding a field is a one line change.
+//
+// Id fields (id, idBoard, ...) are decoded straight to the 12 byte binary
+// struct TrelloId. String fields are views into the JSON they were decoded
+// from, so that buffer has to outlive the model. Use StrUnescape from
+// decode.h before showing a string that has STR_ESCAPED set.
+//
+// Decoding fails with -2 when the value isn't an object, -3 when a field
+// has the wrong type or an ID isn't 24 hex digits and -4 when a string is
+// not valid UTF-8 or has a malformed escape.
+//
+// Requires common.h, json.h (with JSMN_NEXT_LINKS) and decode.h to be
+// included first.
+
+#ifndef JSMN_NEXT_LINKS
+    #error "trello.h decoders skip values with next links, define JSMN_NEXT_LINKS before json.h"
+#endif
+
+#include <stddef.h>
+
+#define BOARD_FIELDS(X, S) \
+    X(S, Id,     id) \
+    X(S, String, name) \
+    X(S, String, desc) \
+    X(S, String, shortUrl) \
+    X(S, Timestamp, dateLastActivity) \
+    X(S, Bool,   closed)
+
+#define LIST_FIELDS(X, S) \
+    X(S, Id,     id) \
+    X(S, String, name) \
+    X(S, Id,     idBoard) \
+    X(S, Number, pos) \
+    X(S, Bool,   closed)
+
+#define CARD_FIELDS(X, S) \
+    X(S, Id,     id) \
+    X(S, String, name) \
+    X(S, String, desc) \
+    X(S, Id,     idBoard) \
+    X(S, Id,     idList) \
+    X(S, String, shortUrl) \
+    X(S, Timestamp, dateLastActivity) \
+    X(S, Number, pos) \
+    X(S, Bool,   closed)
+
+#define LABEL_FIELDS(X, S) \
+    X(S, Id,     id) \
+    X(S, Id,     idBoard) \
+    X(S, String, name) \
+    X(S, String, color)
+
+#define MEMBER_FIELDS(X, S) \
+    X(S, Id,     id) \
+    X(S, String, username) \
+    X(S, String, fullName) \
+    X(S, String, initials)
+
+#define TRELLO_MODELS(X) \
+    X(Board,  BOARD_FIELDS) \
+    X(List,   LIST_FIELDS) \
+    X(Card,   CARD_FIELDS) \
+    X(Label,  LABEL_FIELDS) \
+    X(Member, MEMBER_FIELDS)
+
+// Trello object IDs are 24 hex digits, kept as the 12 bytes they encode
+struct TrelloId {
+    u8 bytes[12];
+};
+
+INLINE b32 TrelloIdEq(struct TrelloId a, struct TrelloId b) {
+    return memcmp(a.bytes, b.bytes, sizeof(a.bytes)) == 0;
+}
+
+INLINE b32 TrelloIdIsZero(struct TrelloId id) {
+    static const struct TrelloId zero;
+    return TrelloIdEq(id, zero);
+}
+
+INLINE u32 TrelloIdHash(struct TrelloId id) {
+    return (u32)HashId96(id.bytes);
+}
+
+INLINE b32 TrelloIdParse(const char *p, u32 len, struct TrelloId *out) {
+    return len == 24 && DecodeHex96(p, out->bytes);
+}
+
+// Writes the 24 digit form and a terminator to `out`
+INLINE char *TrelloIdFormat(struct TrelloId id, char out[25]) {
+    EncodeHex96(id.bytes, out);
+    out[24] = 0;
+    return out;
+}
+
+enum FieldType {
+    FieldType_Id,
+    FieldType_String,
+    FieldType_Number,
+    FieldType_Bool,
+    FieldType_Timestamp
+};
+
+#define FIELD_TYPE_Id     struct TrelloId
+#define FIELD_TYPE_String struct Str
+#define FIELD_TYPE_Number f64
+#define FIELD_TYPE_Bool   b32
+#define FIELD_TYPE_Timestamp u64 // ms since the epoch
+
+#define DECLARE_FIELD(S, type, name) FIELD_TYPE_##type name;
+#define DECLARE_MODEL(S, FIELDS) struct S { FIELDS(DECLARE_FIELD, S) };
+TRELLO_MODELS(DECLARE_MODEL)
+#undef DECLARE_MODEL
+#undef DECLARE_FIELD
+
+struct SchemaField {
+    const char *key;
+    u32 keyLen;
+    enum FieldType type;
+    u32 offset;
+};
+
+#define SCHEMA_SLOTS 64
+#define SCHEMA_SEED_TRIES 4096 // per table size
+
+// `slots` maps a key hash to field index + 1. The key sets are fixed at
+// compile time, so the first decode searches for a multiplier that puts
+// every key of the schema in its own slot and every later lookup is one
+// hash, one compare. The model schemas are all built together, once, by
+// whichever thread decodes first (TrelloSchemasInit). Any other schema is
+// built by its first decode, so build it with SchemaBuild before sharing
+// it between threads.
+//
+// The hash only looks at the length and the first, middle and last bytes.
+// Keys that agree on all four can never be told apart that way, so if no
+// multiplier works the schema falls back to hashing whole keys.
+struct Schema {
+    const char *name;
+    const struct SchemaField *fields;
+    u32 fieldCount;
+
+    u32 seed;
+    u32 shift;
+    b32 fullKeys;
+    u8 slots[SCHEMA_SLOTS];
+};
+
+INLINE u32 SchemaHash(const char *key, u32 len, u32 seed, u32 shift, b32 fullKeys) {
+    u32 h = fullKeys ? (u32)HashBytes(key, len, 0) :
+        len | ((u32)(u8)key[0] << 8) | ((u32)(u8)key[len-1] << 16) | ((u32)(u8)key[len/2] << 24);
+    return (h * seed) >> shift;
+}
+
+// Fills the slots, keeping the first key of any collision. Returns whether
+// there were none.
+INLINE b32 SchemaTrySeed(struct Schema *schema, u32 seed, u32 bits, b32 fullKeys) {
+    b32 perfect = true;
+    memset(schema->slots, 0, sizeof(schema->slots));
+    for (u32 i = 0; i < schema->fieldCount; i += 1) {
+        const struct SchemaField *field = &schema->fields[i];
+        u32 slot = SchemaHash(field->key, field->keyLen, seed, 32 - bits, fullKeys);
+        if (schema->slots[slot])
+            perfect = false;
+        else
+            schema->slots[slot] = (u8)(i + 1);
+    }
+    return perfect;
+}
+
+void SchemaBuild(struct Schema *schema) {
+    u32 minBits = 1;
+    while ((1u << minBits) < schema->fieldCount * 2) minBits += 1;
+    ASSERT((1u << minBits) <= SCHEMA_SLOTS);
+
+    // Smallest table first, then bigger ones, then the same with whole keys
+    for (b32 fullKeys = 0; fullKeys < 2; fullKeys += 1) {
+        for (u32 bits = minBits; (1u << bits) <= SCHEMA_SLOTS; bits += 1) {
+            u32 seed = 0x9E3779B1;
+            for (u32 try = 0; try < SCHEMA_SEED_TRIES; try += 1, seed += 2) {
+                if (SchemaTrySeed(schema, seed, bits, fullKeys)) {
+                    schema->seed = seed;
+                    schema->shift = 32 - bits;
+                    schema->fullKeys = fullKeys;
+                    return;
+                }
+            }
+        }
+    }
+
+    // NOTE(Brett): two keys whose 32 bit hashes collide, leave the schema
+    // usable (the later key just never matches) rather than search forever
+    PANIC("No perfect hash for schema keys");
+    schema->seed = 0x9E3779B1;
+    schema->shift = 32 - minBits;
+    schema->fullKeys = true;
+    SchemaTrySeed(schema, schema->seed, minBits, true);
+}
+
+INLINE const struct SchemaField *SchemaLookup(struct Schema *schema, const char *key, u32 len) {
+    if (len == 0)
+        return NULL;
+
+    u32 slot = SchemaHash(key, len, schema->seed, schema->shift, schema->fullKeys);
+    u8 index = schema->slots[slot];
+    if (!index)
+        return NULL;
+
+    const struct SchemaField *field = &schema->fields[index-1];
+    if (field->keyLen != len || memcmp(field->key, key, len) != 0)
+        return NULL;
+
+    return field;
+}
+
+// Decodes the `len` bytes of a `type` value at `start` into its field.
+// Values are views into the source, so offsets never go through an int.
+int DecodeFieldValue(const struct SchemaField *field, jsmntype_t type, const char *start, u64 len, void *out) {
+    u8 *dest = (u8 *)out + field->offset;
+
+    // null leaves the field zeroed
+    if (type == JSMN_PRIMITIVE && start[0] == 'n')
+        return 0;
+
+    // Str lengths are 32 bit, nothing in a model gets near that
+    if (len > 0xFFFFFFFFull)
+        return -3;
+
+    switch (field->type) {
+    case FieldType_Id: {
+        if (type != JSMN_STRING)
+            return -3;
+        if (!TrelloIdParse(start, (u32)len, (struct TrelloId *)dest))
+            return -3;
+    } break;
+
+    case FieldType_String: {
+        if (type != JSMN_STRING)
+            return -3;
+        i32 flags = JsonStringScan((const u8 *)start, (u32)len);
+        if (flags < 0)
+            return -4;
+        *(struct Str *)dest = StrMake(start, (u32)len, (u32)flags);
+    } break;
+
+    case FieldType_Number: {
+        if (type != JSMN_PRIMITIVE)
+            return -3;
+        if (!JsonParseF64(start, (u32)len, (f64 *)dest))
+            return -3;
+    } break;
+
+    case FieldType_Bool: {
+        if (type != JSMN_PRIMITIVE)
+            return -3;
+        *(b32 *)dest = start[0] == 't';
+    } break;
+
+    case FieldType_Timestamp: {
+        if (type != JSMN_STRING)
+            return -3;
+        if (!ParseIso8601Ms(start, (u32)len, (u64 *)dest))
+            return -3;
+    } break;
+    }
+
+    return 0;
+}
+
+INLINE int DecodeField(const struct SchemaField *field, const char *json, jsmntok_t value, void *out) {
+    return DecodeFieldValue(field, value.type, json + value.start, (u64)(value.end - value.start), out);
+}
+
+// Decodes the object at tokens[*offset] and leaves *offset past it.
+// Unknown keys are skipped with a single jump over their value.
+int DecodeObject(struct Schema *schema, const char *json, jsmntok_t *tokens, int *offset, void *out) {
+    if (!schema->seed)
+        SchemaBuild(schema);
+
+    jsmntok_t obj = tokens[*offset];
+    if (obj.type != JSMN_OBJECT)
+        return -2;
+
+    int index = *offset + 1;
+    for (int i = 0; i < obj.size; i += 1) {
+        jsmntok_t key = tokens[index];
+        int value = key.next;
+
+        const struct SchemaField *field = NULL;
+        if (key.type == JSMN_STRING)
+            field = SchemaLookup(schema, json + key.start, key.end - key.start);
+
+        if (field) {
+            int result = DecodeField(field, json, tokens[value], out);
+            if (result < 0)
+                return result;
+        }
+
+        index = tokens[value].next;
+    }
+
+    *offset = obj.next;
+    return 0;
+}
+
+#define SCHEMA_FIELD(S, type, name) { #name, sizeof(#name)-1, FieldType_##type, offsetof(struct S, name) },
+#define DEFINE_SCHEMA(S, FIELDS) \
+    static const struct SchemaField S##Fields[] = { FIELDS(SCHEMA_FIELD, S) }; \
+    static struct Schema S##Schema = { #S, S##Fields, ArrayCount(S##Fields) };
+TRELLO_MODELS(DEFINE_SCHEMA)
+#undef DEFINE_SCHEMA
+#undef SCHEMA_FIELD
+
+static pthread_once_t trelloSchemasOnce = PTHREAD_ONCE_INIT;
+
+void TrelloSchemasBuild(void) {
+#define BUILD_SCHEMA(S, FIELDS) SchemaBuild(&S##Schema);
+    TRELLO_MODELS(BUILD_SCHEMA)
+#undef BUILD_SCHEMA
+}
+
+// Builds every model schema the first time it's called, from any thread,
+// so the decoders below never build one while another thread reads it
+INLINE void TrelloSchemasInit(void) {
+    pthread_once(&trelloSchemasOnce, TrelloSchemasBuild);
+}
+
+#define DEFINE_DECODER(S, FIELDS) \
+    INLINE int Decode##S(const char *json, jsmntok_t *tokens, int *offset, struct S *out) { \
+        TrelloSchemasInit(); \
+        return DecodeObject(&S##Schema, json, tokens, offset, out); \
+    }
+TRELLO_MODELS(DEFINE_DECODER)
+#undef DEFINE_DECODER
+
+// Parallel decoding of one large top-level array of objects, e.g. a card or
+// action export. The input is indexed once, the elements are found from the
+// index and split into contiguous ranges of roughly equal bytes, and every
+// worker tokenizes and decodes its range straight into its own slots of the
+// output array, so the results are in document order with no stitching copy.
+
+struct DecodeWorker {
+    struct Schema *schema;
+    u32 stride;
+    const char *json;
+    size_t len;
+    const unsigned int *indices;
+    const unsigned int *bounds;
+    u32 first, last;
+    u8 *out;
+    int result;
+    b8 threaded;
+};
+
+void *DecodeWorkerMain(void *payload) {
+    struct DecodeWorker *worker = payload;
+
+    // Tokens come from the worker's own scratch arena, where growing the
+    // buffer is in place and nothing is shared with the other workers
+    struct Arena *scratch = ThreadScratch();
+    struct ArenaTemp temp = {0};
+    struct Allocator a = DefaultHeapAllocator();
+    if (scratch) {
+        temp = ArenaTempBegin(scratch);
+        a = ArenaAllocator(scratch);
+    }
+
+    unsigned int cap = 256;
+    jsmntok_t *tokens = Alloc(a, cap * sizeof(jsmntok_t));
+    if (!tokens)
+        worker->result = JSMN_ERROR_NOMEM;
+
+    for (u32 e = worker->first; e < worker->last && worker->result >= 0; e += 1) {
+        const unsigned int *indices = worker->indices + worker->bounds[2*e];
+        unsigned int count = worker->bounds[2*e+1] - worker->bounds[2*e];
+
+        jsmn_parser parser;
+        jsmn_init(&parser);
+
+        int r;
+        for (;;) {
+            r = jsmn_parse_index(&parser, worker->json, worker->len, indices, count, tokens, cap);
+            if (r != JSMN_ERROR_NOMEM || parser.toknext < cap)
+                break;
+            jsmntok_t *grown = Resize(a, tokens, cap * sizeof(jsmntok_t), cap * 2 * sizeof(jsmntok_t));
+            if (!grown)
+                break;
+            tokens = grown;
+            cap *= 2;
+        }
+
+        if (r < 1) {
+            worker->result = r < 0 ? r : -2;
+            break;
+        }
+
+        int offset = 0;
+        worker->result = DecodeObject(worker->schema, worker->json, tokens, &offset, worker->out + (u64)e * worker->stride);
+    }
+
+    if (scratch)
+        ArenaTempEnd(temp);
+    else if (tokens)
+        Free(a, tokens);
+    return NULL;
+}
+
+// Decodes every element of the array in `json` into a zeroed array of
+// `stride`-sized structs from `a`. Returns the element count or a negative
+// error, JSMN_ERROR_NOMEM when an allocation fails.
+int DecodeArrayParallel(
+    struct Schema *schema,
+    u32 stride,
+    const char *json,
+    size_t len,
+    u32 threadCount,
+    struct Allocator a,
+    void **out
+) {
+    // Built up front so workers only ever read the schema
+    if (!schema->seed)
+        SchemaBuild(schema);
+
+    unsigned int *indices = Alloc(a, (len + 1) * sizeof(unsigned int));
+    if (!indices)
+        return JSMN_ERROR_NOMEM;
+    int indexCount = jsmn_index(json, len, indices);
+    if (indexCount < 0) {
+        Free(a, indices);
+        return indexCount;
+    }
+
+    unsigned int *bounds = Alloc(a, (indexCount + 2) * sizeof(unsigned int));
+    if (!bounds) {
+        Free(a, indices);
+        return JSMN_ERROR_NOMEM;
+    }
+    int count = jsmn_split_array(json, indices, indexCount, bounds);
+    if (count < 0) {
+        Free(a, bounds);
+        Free(a, indices);
+        return count;
+    }
+
+    if (threadCount < 1) threadCount = 1;
+    if (threadCount > (u32)count) threadCount = count ? (u32)count : 1;
+
+    u8 *results = Alloc(a, (u64)count * stride + 1);
+    struct DecodeWorker *workers = Alloc(a, threadCount * sizeof(struct DecodeWorker));
+    pthread_t *threads = Alloc(a, threadCount * sizeof(pthread_t));
+    if (!results || !workers || !threads) {
+        if (threads) Free(a, threads);
+        if (workers) Free(a, workers);
+        if (results) Free(a, results);
+        Free(a, bounds);
+        Free(a, indices);
+        return JSMN_ERROR_NOMEM;
+    }
+    memset(results, 0, (u64)count * stride);
+
+    // Balance by bytes rather than element count, boards vary a lot in size
+    u64 totalBytes = count ? indices[bounds[2*count-1] - 1] - indices[bounds[0]] : 0;
+    u32 element = 0;
+    for (u32 t = 0; t < threadCount; t += 1) {
+        struct DecodeWorker *worker = &workers[t];
+        worker->schema = schema;
+        worker->stride = stride;
+        worker->json = json;
+        worker->len = len;
+        worker->indices = indices;
+        worker->bounds = bounds;
+        worker->out = results;
+        worker->result = 0;
+        worker->threaded = false;
+        worker->first = element;
+
+        u64 target = totalBytes * (t + 1) / threadCount;
+        while (element < (u32)count &&
+                (t == threadCount-1 || indices[bounds[2*element]] - indices[bounds[0]] < target))
+            element += 1;
+        worker->last = element;
+    }
+
+    // A worker whose thread fails to start runs on this thread instead
+    for (u32 t = 1; t < threadCount; t += 1) {
+        workers[t].threaded = pthread_create(&threads[t], NULL, DecodeWorkerMain, &workers[t]) == 0;
+        if (!workers[t].threaded)
+            DecodeWorkerMain(&workers[t]);
+    }
+    DecodeWorkerMain(&workers[0]);
+
+    int result = count;
+    for (u32 t = 0; t < threadCount; t += 1) {
+        if (workers[t].threaded)
+            pthread_join(threads[t], NULL);
+        if (workers[t].result < 0)
+            result = workers[t].result;
+    }
+
+    Free(a, threads);
+    Free(a, workers);
+    Free(a, bounds);
+    Free(a, indices);
+
+    if (result < 0) {
+        Free(a, results);
+        return result;
+    }
+
+    *out = results;
+    return result;
+}
+
+#define DecodeArrayParallelOf(S, json, len, threadCount, a, out) \
+    (TrelloSchemasInit(), DecodeArrayParallel(&S##Schema, sizeof(struct S), json, len, threadCount, a, (void **)(out)))
+
+// Same as DecodeObject, reading from a packed tape
+int DecodeObjectTape(struct Schema *schema, const char *json, const jsmn_tape *tape, unsigned int *index, void *out) {
+    if (!schema->seed)
+        SchemaBuild(schema);
+
+    unsigned int obj = *index;
+    if (jsmn_tape_type(tape, obj) != JSMN_OBJECT)
+        return -2;
+
+    u64 fields = jsmn_tape_size(tape, obj);
+    unsigned int key = jsmn_tape_child(tape, obj);
+    for (u64 i = 0; i < fields; i += 1) {
+        unsigned int value = key + 1;
+
+        const struct SchemaField *field = NULL;
+        if (jsmn_tape_type(tape, key) == JSMN_STRING) {
+            u64 start = jsmn_tape_start(tape, key);
+            field = SchemaLookup(schema, json + start, (u32)(jsmn_tape_end(tape, key) - start));
+        }
+
+        if (field) {
+            u64 start = jsmn_tape_start(tape, value);
+            int result = DecodeFieldValue(field, jsmn_tape_type(tape, value), json + start,
+                jsmn_tape_end(tape, value) - start, out);
+            if (result < 0)
+                return result;
+        }
+
+        key = jsmn_tape_next(tape, value);
+    }
+
+    *index = jsmn_tape_next(tape, obj);
+    return 0;
+}
+
+#define DEFINE_TAPE_DECODER(S, FIELDS) \
+    INLINE int Decode##S##Tape(const char *json, const jsmn_tape *tape, unsigned int *index, struct S *out) { \
+        TrelloSchemasInit(); \
+        return DecodeObjectTape(&S##Schema, json, tape, index, out); \
+    }
+TRELLO_MODELS(DEFINE_TAPE_DECODER)
+#undef DEFINE_TAPE_DECODER
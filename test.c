@@ -2,164 +2,1811 @@
 #include <string.h>
 #include <stdlib.h>
 
+#define JSMN_NEXT_LINKS
+
+#include "src/common.h"
 #include "src/json.h"
+#include "src/decode.h"
+#include "src/trello.h"
+#include "src/cursor.h"
+#include "src/cache.h"
+#include "src/snapshot.h"
+#include "src/store.h"
 
-struct Board {
-    const char *name;
-    const char *id;
-    const char *shortUrl;
-};
+// Tokens and boards both come from `a`, hand it an arena and reset it once
+// the boards are done with
+int parseBoards(const char *json, struct Allocator a, struct Board **boardsOut) {
+    jsmn_parser parser;
+    jsmn_init(&parser);
 
-int keyCmp(const char *key, jsmntok_t field, const char *json) {
-    if (field.type != JSMN_STRING)
-        return 0;
+    jsmntok_t *tokens;
+    int count = jsmn_parse_alloc(&parser, json, strlen(json), a, &tokens);
+    if (count < 1) {
+        printf("Failed to parse json: %d\n", count);
+        return -6;
+    }
+
+    printf("Response had %d tokens\n", count);
+
+    if (tokens[0].type != JSMN_ARRAY) {
+        printf("json type: %d\n", tokens[0].type);
+        Free(a, tokens);
+        return -1;
+    }
+
+    int boardCount = tokens[0].size;
 
-    int fieldLen = field.end - field.start;
-    for (size_t i = 0; i < fieldLen; i += 1) {
-        if (key[i] != json[field.start+i])
-            return 0;
+    struct Board *boards = Alloc(a, boardCount * sizeof(struct Board));
+    if (!boards) {
+        Free(a, tokens);
+        return -3;
     }
+    memset(boards, 0, boardCount * sizeof(struct Board));
 
-    return 1;
+    int offset = 1;
+    for (size_t boardIndex = 0; boardIndex < boardCount; boardIndex++) {
+        struct Board *board = boards+boardIndex;
+        if (DecodeBoard(json, tokens, &offset, board) < 0) {
+            // TODO(Brett): error label and cleanup allocations
+            Free(a, tokens);
+            return -2;
+        }
+    }
+
+    Free(a, tokens);
+
+    *boardsOut = boards;
+    return boardCount;
 }
 
-int extractString(
-    const char *key,
-    jsmntok_t field,
-    jsmntok_t *child,
-    const char *json,
-    const char **out
-) {
-    if (field.type != JSMN_STRING)
-        return 0;
+int benchScalar(const char *json, size_t len, jsmntok_t *tokens, unsigned int cap) {
+    jsmn_parser parser;
+    jsmn_init(&parser);
+    int count = jsmn_parse(&parser, json, len, NULL, 0);
+    if (count < 0 || (unsigned int)count > cap)
+        return -1;
+
+    jsmn_init(&parser);
+    return jsmn_parse(&parser, json, len, tokens, count);
+}
 
-    int fieldLen = field.end - field.start;
-    for (size_t i = 0; i < fieldLen; i += 1) {
-        if (key[i] != json[field.start+i])
-            return 0;
+int benchAlloc(const char *json, size_t len, jsmntok_t *tokens) {
+    jsmn_parser parser;
+    jsmn_init(&parser);
+    jsmntok_t *parsed;
+    struct Allocator heap = DefaultHeapAllocator();
+    int count = jsmn_parse_alloc(&parser, json, len, heap, &parsed);
+    if (count > 0) {
+        memcpy(tokens, parsed, count * sizeof(jsmntok_t));
+        Free(heap, parsed);
     }
+    return count;
+}
 
-    if (child->type != JSMN_STRING) {
-        return -3;
+int benchIndexed(const char *json, size_t len, unsigned int *indices, jsmntok_t *tokens) {
+    jsmn_parser parser;
+    jsmn_init(&parser);
+    int indexCount = jsmn_index(json, len, indices);
+    return jsmn_parse_index(&parser, json, len, indices, indexCount, tokens, indexCount);
+}
+
+void benchParse(const char *name, const char *json, size_t len) {
+    unsigned int *indices = malloc(len * sizeof(unsigned int) + 1);
+    jsmntok_t *scalarTokens = calloc(len + 1, sizeof(jsmntok_t));
+    jsmntok_t *indexedTokens = calloc(len + 1, sizeof(jsmntok_t));
+
+    int iterations = (int)(MB(64) / (len + 1)) + 1;
+    usTimer timer;
+    int scalarCount = 0, indexedCount = 0;
+
+    usTimerInit(&timer);
+    for (int i = 0; i < iterations; i += 1)
+        scalarCount = benchScalar(json, len, scalarTokens, (unsigned int)len + 1);
+    unsigned long scalarUs = GetTimeus(&timer);
+
+    usTimerInit(&timer);
+    for (int i = 0; i < iterations; i += 1)
+        indexedCount = benchIndexed(json, len, indices, indexedTokens);
+    unsigned long indexedUs = GetTimeus(&timer);
+
+    b32 same = scalarCount == indexedCount && scalarCount > 0 &&
+        memcmp(scalarTokens, indexedTokens, scalarCount * sizeof(jsmntok_t)) == 0;
+
+    usTimerInit(&timer);
+    for (int i = 0; i < iterations; i += 1)
+        indexedCount = benchAlloc(json, len, indexedTokens);
+    unsigned long allocUs = GetTimeus(&timer);
+
+    same = same && scalarCount == indexedCount &&
+        memcmp(scalarTokens, indexedTokens, scalarCount * sizeof(jsmntok_t)) == 0;
+
+    f64 mb = (f64)len * iterations / MB(1);
+    printf("%-12s %9zu bytes %8d tokens  jsmn_parse x2: %8.1f MB/s  jsmn_index: %8.1f MB/s  jsmn_parse_alloc: %8.1f MB/s  %s\n",
+        name, len, indexedCount,
+        mb / (scalarUs / 1000000.0), mb / (indexedUs / 1000000.0), mb / (allocUs / 1000000.0),
+        same ? "match" : "MISMATCH");
+
+    free(indices);
+    free(scalarTokens);
+    free(indexedTokens);
+}
+
+// Repeats the elements of a top-level array `copies` times
+char *synthesizeArray(const char *json, size_t len, int copies, size_t *lenOut) {
+    const char *open = memchr(json, '[', len);
+    const char *close = json + len;
+    while (close > json && *close != ']') close--;
+    if (!open || close <= open) return NULL;
+
+    size_t innerLen = close - (open+1);
+    char *out = malloc((innerLen + 1) * copies + 3);
+    size_t offset = 0;
+    out[offset++] = '[';
+    for (int i = 0; i < copies; i += 1) {
+        if (i > 0) out[offset++] = ',';
+        memcpy(out + offset, open+1, innerLen);
+        offset += innerLen;
     }
+    out[offset++] = ']';
+    out[offset] = '\0';
 
-    *out = strndup(json + child->start, child->end - child->start);
-    return 1;
+    *lenOut = offset;
+    return out;
 }
 
-void skipTokens(jsmntok_t *tokens, int *index) {
-    switch (tokens[*index].type) {
-    case JSMN_PRIMITIVE:
-    case JSMN_STRING:
-    case JSMN_UNDEFINED:
-        *index = (*index)+1;
-        break;
+// Reads only the fields we display, without tokenizing the rest of each board
+// The boards come back as an Array from `a`, free them with ArrayFree
+int parseBoardsOnDemand(const char *json, size_t len, struct Allocator a, Array(struct Board) *boardsOut) {
+    struct JsonCursor array = JsonCursorInit(json, (u32)len);
+    if (JsonCursorType(&array) != '[')
+        return -1;
 
-    case JSMN_ARRAY: {
-        int start = *index;
-        jsmntok_t arry = tokens[start++];
+    Array(struct Board) boards;
+    ArrayInit(boards, a);
 
-        for (size_t i = 0; i < arry.size; i++) {
-            skipTokens(tokens, &start);
+    struct JsonCursor element;
+    while (JsonArrayNext(&array, &element)) {
+        if (JsonCursorType(&element) != '{') {
+            ArrayFree(boards);
+            return -2;
         }
 
-        *index = start;
-    } break;
+        struct Board empty = {0};
+        ArrayPush(boards, empty);
+
+        struct Board *board = &ArrayLast(boards);
+        struct JsonCursor value;
+        if (JsonObjectFind(&element, "name", &value))
+            JsonGetString(&value, &board->name);
+        struct Str id;
+        if (JsonObjectFind(&element, "id", &value) && JsonGetString(&value, &id))
+            TrelloIdParse(id.data, id.len, &board->id);
+        if (JsonObjectFind(&element, "shortUrl", &value))
+            JsonGetString(&value, &board->shortUrl);
+    }
+
+    *boardsOut = boards;
+    return (int)ArrayLen(boards);
+}
+
+u32 threadCount() {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (u32)count : 1;
+}
+
+void benchDecode(const char *name, const char *json, size_t len) {
+    struct Allocator heap = DefaultHeapAllocator();
+    usTimer timer;
+
+    usTimerInit(&timer);
+    jsmn_parser parser;
+    jsmn_init(&parser);
+    jsmntok_t *tokens;
+    int count = jsmn_parse_alloc(&parser, json, len, heap, &tokens);
+    int boardCount = count > 0 ? tokens[0].size : 0;
+    struct Board *boards = calloc(boardCount, sizeof(struct Board));
+    int offset = 1;
+    for (int i = 0; i < boardCount; i += 1)
+        DecodeBoard(json, tokens, &offset, &boards[i]);
+    unsigned long sequentialUs = GetTimeus(&timer);
+
+    u32 threads = threadCount();
+    struct Board *parallel = NULL;
+    usTimerInit(&timer);
+    int parallelCount = DecodeArrayParallelOf(Board, json, len, threads, heap, &parallel);
+    unsigned long parallelUs = GetTimeus(&timer);
+
+    b32 same = parallelCount == boardCount &&
+        memcmp(boards, parallel, boardCount * sizeof(struct Board)) == 0;
+
+    printf("%-12s %8d boards  sequential decode: %8luus  parallel decode (%u threads): %8luus  %s\n",
+        name, boardCount, sequentialUs, threads, parallelUs, same ? "match" : "MISMATCH");
+
+    Array(struct Board) onDemand;
+    usTimerInit(&timer);
+    int onDemandCount = parseBoardsOnDemand(json, len, heap, &onDemand);
+    unsigned long onDemandUs = GetTimeus(&timer);
+
+    same = onDemandCount == boardCount;
+    for (int i = 0; same && i < boardCount; i += 1) {
+        same = TrelloIdEq(onDemand[i].id, boards[i].id) && StrEq(onDemand[i].name, boards[i].name) &&
+            StrEq(onDemand[i].shortUrl, boards[i].shortUrl);
+    }
+
+    printf("%-12s %8d boards  on-demand id/name/shortUrl: %8luus  %s\n",
+        name, onDemandCount, onDemandUs, same ? "match" : "MISMATCH");
+    if (onDemandCount >= 0)
+        ArrayFree(onDemand);
+
+    Free(heap, tokens);
+    free(boards);
+    if (parallelCount > 0)
+        Free(heap, parallel);
+}
+
+// Token memory and decode time for jsmntok_t vs the packed tape
+void benchTape(const char *name, const char *json, size_t len) {
+    struct Allocator heap = DefaultHeapAllocator();
+    usTimer timer;
+
+    unsigned int *indices = malloc((len + 1) * sizeof(unsigned int));
+    int numIndices = jsmn_index(json, len, indices);
+
+    jsmn_parser parser;
+    jsmn_init(&parser);
+    jsmntok_t *tokens = malloc((numIndices + 1) * sizeof(jsmntok_t));
+    int count = jsmn_parse_index(&parser, json, len, indices, numIndices, tokens, numIndices + 1);
 
-    case JSMN_OBJECT: {
-        int start = *index;
-        jsmntok_t obj = tokens[start++];
+    uint64_t *tapeIndices = malloc((len + 1) * sizeof(uint64_t));
+    int numTapeIndices = jsmn_index64(json, len, tapeIndices);
 
-        for (size_t i = 0; i < obj.size; i++) {
-            skipTokens(tokens, &start); // key
-            skipTokens(tokens, &start); // value
+    jsmn_tape tape;
+    usTimerInit(&timer);
+    int entries = jsmn_tape_build(json, len, tapeIndices, numTapeIndices, heap, &tape);
+    unsigned long buildUs = GetTimeus(&timer);
+    free(tapeIndices);
+
+    if (count < 1 || entries < 1) {
+        printf("%-12s failed to build tape: %d/%d\n", name, count, entries);
+        free(tokens);
+        free(indices);
+        return;
+    }
+
+    int boardCount = tokens[0].size;
+    struct Board *boards = calloc(boardCount, sizeof(struct Board));
+    struct Board *tapeBoards = calloc(boardCount, sizeof(struct Board));
+
+    usTimerInit(&timer);
+    int offset = 1;
+    for (int i = 0; i < boardCount; i += 1)
+        DecodeBoard(json, tokens, &offset, &boards[i]);
+    unsigned long tokenUs = GetTimeus(&timer);
+
+    usTimerInit(&timer);
+    unsigned int index = jsmn_tape_child(&tape, 0);
+    for (int i = 0; i < boardCount; i += 1)
+        DecodeBoardTape(json, &tape, &index, &tapeBoards[i]);
+    unsigned long tapeUs = GetTimeus(&timer);
+
+    b32 same = jsmn_tape_size(&tape, 0) == (u64)boardCount &&
+        memcmp(boards, tapeBoards, boardCount * sizeof(struct Board)) == 0;
+
+    printf("%-12s tokens: %8zu bytes decode %8luus  tape: %8zu bytes (%u wide) build %8luus decode %8luus  %s\n",
+        name, (size_t)count * sizeof(jsmntok_t), tokenUs,
+        (size_t)entries * sizeof(jsmntape_t), tape.wide_count, buildUs, tapeUs, same ? "match" : "MISMATCH");
+
+    free(boards);
+    free(tapeBoards);
+    jsmn_tape_free(&tape, heap);
+    free(tokens);
+    free(indices);
+}
+
+int bench(const char *json) {
+    size_t len = strlen(json);
+    benchParse("file", json, len);
+    benchDecode("file", json, len);
+    benchTape("file", json, len);
+
+    static const int copies[] = { 16, 128 };
+    for (size_t i = 0; i < ArrayCount(copies); i += 1) {
+        char name[32];
+        size_t synthLen;
+        char *synth = synthesizeArray(json, len, copies[i], &synthLen);
+        if (!synth) {
+            printf("Input is not a top-level array\n");
+            return 1;
         }
 
-        *index = start;
-    } break;
+        snprintf(name, sizeof(name), "file x%d", copies[i]);
+        benchParse(name, synth, synthLen);
+        benchDecode(name, synth, synthLen);
+        benchTape(name, synth, synthLen);
+        free(synth);
     }
+
+    return 0;
 }
 
-int parseBoards(const char *json, struct Board **boardsOut) {
+// The line is built in `temp`, like text drawn for a frame
+void printBoard(struct Allocator temp, struct Board *board) {
+    char id[25];
+    struct Str name = StrUnescape(temp, board->name);
+    struct Str shortUrl = StrUnescape(temp, board->shortUrl);
+
+    u32 size = 64 + name.len + shortUrl.len;
+    char *line = Alloc(temp, size);
+    snprintf(line, size, "  id: '%s', name: '%.*s', shortUrl: '%.*s'\n", TrelloIdFormat(board->id, id), StrArg(name), StrArg(shortUrl));
+    fputs(line, stdout);
+
+    Free(temp, line);
+    if (name.data != board->name.data) Free(temp, (void *)name.data);
+    if (shortUrl.data != board->shortUrl.data) Free(temp, (void *)shortUrl.data);
+}
+
+// NOTE(Brett): boards decoded here point into the chunk being streamed, so
+// they have to be used before the callback returns
+struct BoardStream {
+    struct Allocator temp;
+    usTimer timer;
+    unsigned long firstBoardUs;
+};
+
+int streamBoard(void *userdata, const char *json, size_t len) {
+    struct BoardStream *stream = userdata;
+
     jsmn_parser parser;
     jsmn_init(&parser);
 
-    size_t jsonLen = strlen(json);
-    int tokenCount = jsmn_parse(&parser, json, jsonLen, NULL, 0);
-    if (tokenCount < 1) {
-        printf("Failed to parse json: %d\n", tokenCount);
+    jsmntok_t *tokens;
+    int count = jsmn_parse_alloc(&parser, json, len, stream->temp, &tokens);
+    if (count < 1) {
+        printf("Failed to parse board: %d\n", count);
         return -6;
     }
 
-    printf("Response had %d tokens\n", tokenCount);
+    struct Board board = {0};
+    int offset = 0;
+    int result = DecodeBoard(json, tokens, &offset, &board);
+    Free(stream->temp, tokens);
+    if (result < 0) {
+        return result;
+    }
+
+    if (!stream->firstBoardUs)
+        stream->firstBoardUs = GetTimeus(&stream->timer);
+
+    printBoard(stream->temp, &board);
+    return 0;
+}
+
+// Feeds the file through jsmn_stream in socket-sized chunks
+int streamBoards(FILE *file) {
+    struct BoardStream boardStream = {0};
+    boardStream.temp = DefaultHeapAllocator();
+    usTimerInit(&boardStream.timer);
+
+    jsmn_stream stream;
+    jsmn_stream_init(&stream, DefaultHeapAllocator(), streamBoard, &boardStream);
+
+    char chunk[KB(4)];
+    size_t bytesRead;
+    while ((bytesRead = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        int result = jsmn_stream_feed(&stream, chunk, bytesRead);
+        if (result < 0) {
+            jsmn_stream_finish(&stream);
+            printf("Failed to stream response (%d)\n", result);
+            return 1;
+        }
+    }
+
+    int boardCount = jsmn_stream_finish(&stream);
+    if (boardCount < 0) {
+        printf("Failed to stream response (%d)\n", boardCount);
+        return 1;
+    }
+
+    printf("Streamed %d boards, first after %luus, all after %luus\n",
+        boardCount, boardStream.firstBoardUs, GetTimeus(&boardStream.timer));
+    return 0;
+}
+
+// Loads boards from `<path>.tape`, rebuilding the cache first if it's
+// missing, unreadable or older than the response it was built from
+int cachedBoards(const char *path) {
+    struct Allocator heap = DefaultHeapAllocator();
+    char cachePath[1024];
+    snprintf(cachePath, sizeof(cachePath), "%s.tape", path);
+
+    struct stat source, cached;
+    b32 stale = stat(path, &source) == 0 &&
+        (stat(cachePath, &cached) != 0 || cached.st_mtime < source.st_mtime);
+
+    usTimer timer;
+    usTimerInit(&timer);
+
+    struct TapeCache cache;
+    int result = stale ? -1 : TapeCacheOpen(cachePath, true, &cache);
+    if (result < 0) {
+        FILE *file = fopen(path, "r");
+        if (!file) {
+            printf("Failed to open file\n");
+            return 1;
+        }
+
+        char *json = calloc(1, 1024 * 1024 + 1);
+        size_t len = fread(json, 1, 1024 * 1024, file);
+        fclose(file);
+
+        uint64_t *indices = malloc((len + 1) * sizeof(uint64_t));
+        jsmn_tape tape;
+        int entries = jsmn_tape_build(json, len, indices, jsmn_index64(json, len, indices), heap, &tape);
+        free(indices);
+        if (entries < 1) {
+            printf("Failed to parse response (%d)\n", entries);
+            return 1;
+        }
+
+        result = TapeCacheWrite(cachePath, json, len, &tape);
+        jsmn_tape_free(&tape, heap);
+        free(json);
+        if (result == 0)
+            result = TapeCacheOpen(cachePath, true, &cache);
+        if (result < 0) {
+            printf("Failed to write tape cache (%d)\n", result);
+            return 1;
+        }
+        printf("Rebuilt %s in %luus\n", cachePath, GetTimeus(&timer));
+    } else {
+        printf("Loaded %s in %luus\n", cachePath, GetTimeus(&timer));
+    }
+
+    jsmn_tape *tape = &cache.tape;
+    if (jsmn_tape_type(tape, 0) != JSMN_ARRAY) {
+        printf("Cached response is not an array\n");
+        TapeCacheClose(&cache);
+        return 1;
+    }
+
+    int boardCount = (int)jsmn_tape_size(tape, 0);
+    struct Board *boards = calloc(boardCount, sizeof(struct Board));
+    unsigned int index = jsmn_tape_child(tape, 0);
+    for (int i = 0; i < boardCount; i += 1) {
+        result = DecodeBoardTape(cache.json, tape, &index, &boards[i]);
+        if (result < 0) {
+            printf("Failed to decode board %d (%d)\n", i, result);
+            TapeCacheClose(&cache);
+            return 1;
+        }
+    }
+
+    printf("Parsed %d boards:\n", boardCount);
+    for (int i = 0; i < boardCount; i += 1)
+        printBoard(heap, &boards[i]);
+
+    free(boards);
+    TapeCacheClose(&cache);
+    return 0;
+}
+
+// Decodes `path` and writes its boards to `<path>.snap`
+int convertSnapshot(const char *path, const char *json) {
+    struct Board *boards;
+    int boardCount = parseBoards(json, DefaultHeapAllocator(), &boards);
+    if (boardCount < 0) {
+        printf("Failed to parse response (%d)\n", boardCount);
+        return 1;
+    }
+
+    char snapshotPath[1024];
+    snprintf(snapshotPath, sizeof(snapshotPath), "%s.snap", path);
+
+    struct SnapshotModels models = {0};
+    models.BoardItems = boards;
+    models.BoardCount = (u32)boardCount;
+
+    usTimer timer;
+    usTimerInit(&timer);
+    int result = SnapshotWrite(snapshotPath, &models);
+    if (result < 0) {
+        printf("Failed to write %s (%d)\n", snapshotPath, result);
+        return 1;
+    }
+
+    printf("Wrote %d boards to %s in %luus\n", boardCount, snapshotPath, GetTimeus(&timer));
+    Free(DefaultHeapAllocator(), boards);
+    return 0;
+}
+
+b32 snapshotEqual_String(struct Snapshot *snapshot, struct RelStr record, struct Str value) {
+    struct Str unescaped = StrUnescape(DefaultHeapAllocator(), value);
+    b32 equal = StrEq(SnapshotStr(snapshot, record), unescaped);
+    if (unescaped.data != value.data) Free(DefaultHeapAllocator(), (void *)unescaped.data);
+    return equal;
+}
+
+b32 snapshotEqual_Id(struct Snapshot *snapshot, struct TrelloId record, struct TrelloId value) { return TrelloIdEq(record, value); }
+b32 snapshotEqual_Number(struct Snapshot *snapshot, f64 record, f64 value) { return record == value; }
+b32 snapshotEqual_Bool(struct Snapshot *snapshot, b32 record, b32 value) { return record == value; }
+b32 snapshotEqual_Timestamp(struct Snapshot *snapshot, u64 record, u64 value) { return record == value; }
+
+// Checks `<path>.snap` against a fresh decode of `path`
+int verifySnapshot(const char *path, const char *json) {
+    char snapshotPath[1024];
+    snprintf(snapshotPath, sizeof(snapshotPath), "%s.snap", path);
+
+    usTimer timer;
+    usTimerInit(&timer);
+    struct Snapshot snapshot;
+    int result = SnapshotOpen(snapshotPath, true, &snapshot);
+    unsigned long loadUs = GetTimeus(&timer);
+    if (result < 0) {
+        printf("Failed to load %s (%d)\n", snapshotPath, result);
+        return 1;
+    }
+
+    usTimerInit(&timer);
+    struct Board *boards;
+    int boardCount = parseBoards(json, DefaultHeapAllocator(), &boards);
+    unsigned long parseUs = GetTimeus(&timer);
+    if (boardCount < 0) {
+        printf("Failed to parse response (%d)\n", boardCount);
+        SnapshotClose(&snapshot);
+        return 1;
+    }
+
+    int mismatches = snapshot.BoardCount == (u32)boardCount ? 0 : 1;
+    for (u32 i = 0; !mismatches && i < snapshot.BoardCount; i += 1) {
+        const struct BoardRecord *record = &snapshot.BoardRecords[i];
+#define CHECK_FIELD(S, type, name) \
+        if (!snapshotEqual_##type(&snapshot, record->name, boards[i].name)) { \
+            printf("Board %u: " #name " differs\n", i); \
+            mismatches += 1; \
+        }
+        BOARD_FIELDS(CHECK_FIELD, Board)
+#undef CHECK_FIELD
+    }
+
+    printf("Snapshot %s: %u boards, %llu bytes, loaded in %luus (decode from json %luus)\n",
+        mismatches ? "MISMATCH" : "matches", snapshot.BoardCount, (unsigned long long)snapshot.size, loadUs, parseUs);
+
+    Free(DefaultHeapAllocator(), boards);
+    SnapshotClose(&snapshot);
+    return mismatches ? 1 : 0;
+}
+
+// Loads the boards into a Store and prints them back out of its columns
+int storeBoards(const char *json) {
+    struct Board *boards;
+    int boardCount = parseBoards(json, DefaultHeapAllocator(), &boards);
+    if (boardCount < 0) {
+        printf("Failed to parse response (%d)\n", boardCount);
+        return 1;
+    }
+
+    struct Store store;
+    StoreInit(&store, DefaultHeapAllocator());
+    for (int i = 0; i < boardCount; i += 1)
+        StoreAddBoard(&store, &boards[i]);
+    Free(DefaultHeapAllocator(), boards);
+
+    printf("Stored %u boards (%u bytes per row), %u strings in %u bytes:\n",
+        store.boards.count, BoardRowBytes(), store.strings.count, store.strings.bytesLen);
+    for (u32 i = 0; i < store.boards.count; i += 1) {
+        char id[25];
+        struct Str name = StoreStr(&store, store.boards.name[i]);
+        u32 row = StoreFind(&store, boards, store.boards.id[i]);
+        printf("  id: '%s', name: '%.*s'%s\n", TrelloIdFormat(store.boards.id[i], id), StrArg(name), row == i ? "" : " (BAD INDEX)");
+    }
+
+    StoreFree(&store);
+    return 0;
+}
+
+TABLE(U32Table, u32)
+
+// --checks: correctness checks that don't need a response. Each one counts
+// its failures and says which line failed.
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        failures += 1; \
+    } \
+} while (0)
+
+// Never has any memory to give
+ALLOC_FUNC(outOfMemoryAllocFunc) {
+    return NULL;
+}
+
+struct CheckCard {
+    struct TrelloId id;
+    u32 list;
+    f64 pos;
+};
+
+TABLE(CheckCardMap, struct CheckCard)
+TABLE(CheckNameMap, const char *)
+
+int checkTables() {
+    int failures = 0;
+    struct Allocator heap = DefaultHeapAllocator();
+
+    struct CheckCardMap cards;
+    CheckCardMapInit(&cards, heap);
+    for (u32 i = 0; i < 1000; i += 1) {
+        struct CheckCard card = {0};
+        card.list = i % 7;
+        card.pos = i * 0.5;
+        CheckCardMapSet(&cards, i * 31, card);
+    }
+    CHECK(cards.len == 1000);
+    for (u32 i = 0; i < 1000; i += 1) {
+        struct CheckCard *card = CheckCardMapGet(&cards, i * 31);
+        CHECK(card && card->list == i % 7 && card->pos == i * 0.5);
+    }
+    CHECK(CheckCardMapRemove(&cards, 31) && !CheckCardMapGet(&cards, 31));
+    CheckCardMapFree(&cards);
+
+    struct CheckNameMap names;
+    CheckNameMapInit(&names, heap);
+    CheckNameMapSet(&names, 1, "one");
+    CheckNameMapSet(&names, 2, "two");
+    CheckNameMapSet(&names, 1, "uno");
+    const char **name = CheckNameMapGet(&names, 1);
+    CHECK(names.len == 2 && name && strcmp(*name, "uno") == 0);
+    CHECK(!CheckNameMapGet(&names, 3));
+    CheckNameMapFree(&names);
+
+    return failures;
+}
+
+struct CheckNode;
+RelPtrDecl(CheckNodeRef, struct CheckNode);
+
+struct CheckNode {
+    CheckNodeRef next;
+    RelPtr(struct CheckNode) self;
+    struct RelStr name;
+    u32 value;
+};
+
+u32 checkNodeValue(void *base, CheckNodeRef ref) {
+    struct CheckNode *node = RelGet(base, ref);
+    return node ? node->value : 0;
+}
+
+// Links nodes through RelPtrs, then copies the block elsewhere and walks
+// the copy
+int checkRelPtrs() {
+    int failures = 0;
+
+    struct Arena *arena = ArenaCreate(MB(16));
+    u8 *base = arena->base;
+    ArenaPush(arena, RELPTR_ALIGN, RELPTR_ALIGN); // the base itself is NULL
+
+    CHECK(sizeof(CheckNodeRef) == 4 && _Alignof(CheckNodeRef) == 4);
+    CHECK(sizeof(struct CheckNode) == 20);
+
+    CheckNodeRef head = {0};
+    CHECK(RelIsNull(head) && RelGet(base, head) == NULL);
+    CHECK(checkNodeValue(base, head) == 0);
+
+    static const char *names[] = { "one", "two", "three" };
+    for (u32 i = 0; i < ArrayCount(names); i += 1) {
+        struct CheckNode *node = ArenaPush(arena, sizeof(*node), RELPTR_ALIGN);
+        char *name = ArenaPush(arena, strlen(names[i]), 1);
+        memcpy(name, names[i], strlen(names[i]));
+
+        node->next = head;
+        RelSet(base, node->self, node);
+        node->name = RelStrMake(base, StrMake(name, (u32)strlen(names[i]), 0));
+        node->value = i + 1;
+        RelSet(base, head, node);
+    }
+
+    u8 *copy = malloc(arena->used);
+    memcpy(copy, base, arena->used);
+    memset(base, 0, arena->used);
+
+    u32 count = 0;
+    for (struct CheckNode *node = RelGet(copy, head); node; node = RelGet(copy, node->next)) {
+        u32 i = ArrayCount(names) - 1 - count;
+        CHECK(node->value == i + 1);
+        CHECK(RelGet(copy, node->self) == node);
+        CHECK(StrEqC(RelStrGet(copy, node->name), names[i]));
+        count += 1;
+    }
+    CHECK(count == ArrayCount(names));
+    CHECK(checkNodeValue(copy, head) == ArrayCount(names));
+
+    struct CheckNode *last = RelGet(copy, head);
+    CHECK(RelSet(copy, last->next, (struct CheckNode *)NULL));
+    CHECK(RelIsNull(last->next));
+
+    // Targets a RelPtr can't hold are stored as NULL, in release builds too
+    CHECK(!RelSet(copy, last->next, (struct CheckNode *)(copy + RELPTR_ALIGN + 1)));
+    CHECK(RelIsNull(last->next));
+    CHECK(!RelSet(copy + RELPTR_ALIGN, last->next, (struct CheckNode *)copy));
+    CHECK(!RelSet(copy, last->next, (struct CheckNode *)copy));
+    CHECK(RelIsNull(last->next));
+    struct RelStr before = RelStrMake(copy + 1, StrMake((const char *)copy, 4, 0));
+    CHECK(before.offset == 0 && before.len == 0);
+
+    free(copy);
+    ArenaDestroy(arena);
+    return failures;
+}
+
+// Keys that only differ away from the first, middle and last byte need the
+// whole-key fallback
+int checkSchemas() {
+    int failures = 0;
+
+    static const struct SchemaField fields[] = {
+        { "axbyc", 5, FieldType_Number, 0 },
+        { "azbwc", 5, FieldType_Number, 8 },
+        { "id",    2, FieldType_Id,     16 },
+    };
+    struct Schema schema = { "Check", fields, ArrayCount(fields) };
+    SchemaBuild(&schema);
+
+    CHECK(schema.seed != 0 && schema.fullKeys);
+    for (u32 i = 0; i < ArrayCount(fields); i += 1)
+        CHECK(SchemaLookup(&schema, fields[i].key, fields[i].keyLen) == &fields[i]);
+    CHECK(SchemaLookup(&schema, "aqbqc", 5) == NULL);
+    CHECK(SchemaLookup(&schema, "name", 4) == NULL);
+
+    // The Trello schemas are built together and should all get by on the
+    // cheap hash
+    TrelloSchemasInit();
+#define CHECK_MODEL_SCHEMA(S, FIELDS) \
+    CHECK(S##Schema.seed != 0 && !S##Schema.fullKeys);
+    TRELLO_MODELS(CHECK_MODEL_SCHEMA)
+#undef CHECK_MODEL_SCHEMA
+
+    return failures;
+}
+
+// Label slots are counted per board
+int checkStoreLabels() {
+    int failures = 0;
+
+    struct Store store;
+    StoreInit(&store, DefaultHeapAllocator());
+
+    struct Board boards[2] = {0};
+    boards[0].id.bytes[0] = 1;
+    boards[1].id.bytes[0] = 2;
+    StoreAddBoard(&store, &boards[0]);
+    StoreAddBoard(&store, &boards[1]);
+
+    for (u32 i = 0; i < 100; i += 1) {
+        struct Label label = {0};
+        label.id.bytes[0] = 3;
+        label.id.bytes[1] = (u8)i;
+        label.idBoard = boards[i & 1].id;
+        if (i == 99)
+            label.idBoard.bytes[0] = 9; // no such board
+        u32 row = StoreAddLabel(&store, &label);
+        u32 expected = i == 99 ? 0xFF : i / 2 < 64 ? i / 2 : 0xFF;
+        CHECK(store.labels.slot[row] == expected);
+    }
+    CHECK(store.boards.labelCount[0] == 50 && store.boards.labelCount[1] == 49);
+
+    StoreFree(&store);
+    return failures;
+}
+
+// Dates that don't exist and numbers JSON doesn't allow are refused
+int checkDecodeEdges() {
+    int failures = 0;
+
+    u64 ms;
+    CHECK(ParseIso8601Ms("2024-02-29T00:00:00.000Z", 24, &ms) && ms == 1709164800000ull);
+    CHECK(ParseIso8601Ms("2000-02-29T12:00:00Z", 20, &ms));
+    CHECK(!ParseIso8601Ms("2023-02-29T00:00:00.000Z", 24, &ms));
+    CHECK(!ParseIso8601Ms("1900-02-29T00:00:00.000Z", 24, &ms));
+    CHECK(!ParseIso8601Ms("2023-04-31T00:00:00.000Z", 24, &ms));
+
+    f64 value;
+    CHECK(JsonParseF64("0", 1, &value) && value == 0);
+    CHECK(JsonParseF64("-0.5", 4, &value) && value == -0.5);
+    CHECK(JsonParseF64("0e3", 3, &value) && value == 0);
+    CHECK(JsonParseF64("10", 2, &value) && value == 10);
+    CHECK(!JsonParseF64("0123", 4, &value));
+    CHECK(!JsonParseF64("-00.5", 5, &value));
+    CHECK(!JsonParseF64("00", 2, &value));
+
+    return failures;
+}
+
+// Empty strs with NULL data compare without handing NULL to memcmp, which
+// UBSan builds catch
+int checkStrs() {
+    int failures = 0;
+
+    struct Str none = StrMake(NULL, 0, 0);
+    CHECK(StrEq(none, none) && StrEq(none, StrMake("", 0, 0)) && StrEqC(none, ""));
+    CHECK(!StrEq(none, StrMake("a", 1, 0)) && !StrEqC(none, "a"));
+    CHECK(StrEqC(StrMake("ab", 2, 0), "ab") && !StrEqC(StrMake("ab", 2, 0), "ac"));
+
+    return failures;
+}
+
+// IDs only resolve within their own table, lists sort in O(n log n) however
+// the cards arrive, and a store with no memory fails cleanly
+int checkStoreRefs() {
+    int failures = 0;
+
+    struct Store store;
+    CHECK(StoreInit(&store, DefaultHeapAllocator()));
+
+    struct Board board = {0};
+    board.id.bytes[0] = 1;
+    struct List list = {0};
+    list.id.bytes[0] = 2;
+    list.idBoard = board.id;
+    u32 boardRow = StoreAddBoard(&store, &board);
+    u32 listRow = StoreAddList(&store, &list);
+    CHECK(boardRow == 0 && listRow == 0 && store.lists.board[listRow] == boardRow);
+
+    // A card pointing at a list's ID as its board, and at the board's ID as
+    // its list, resolves neither
+    struct Card card = {0};
+    card.id.bytes[0] = 3;
+    card.idBoard = list.id;
+    card.idList = board.id;
+    u32 cardRow = StoreAddCard(&store, &card);
+    CHECK(store.cards.board[cardRow] == STORE_NONE && store.cards.list[cardRow] == STORE_NONE);
+    CHECK(StoreFind(&store, cards, card.id) == cardRow && StoreFind(&store, lists, card.id) == STORE_NONE);
+    CHECK(!StoreCardAddLabel(&store, cardRow, list.id));
+
+    // Reverse order was quadratic for the insertion sort
+    u32 cardCount = 20000;
+    for (u32 i = 0; i < cardCount; i += 1) {
+        struct Card reversed = {0};
+        reversed.id.bytes[0] = 4;
+        memcpy(&reversed.id.bytes[1], &i, sizeof(i));
+        reversed.idList = list.id;
+        reversed.pos = (f64)(cardCount - i / 2);
+        StoreAddCard(&store, &reversed);
+    }
+    Array(u32) rows;
+    ArrayInit(rows, DefaultHeapAllocator());
+    CHECK(StoreCardsInList(&store, listRow, &rows) == cardCount);
+    b32 sorted = true;
+    for (u32 i = 1; i < cardCount; i += 1) {
+        f64 prev = store.cards.pos[rows[i - 1]], pos = store.cards.pos[rows[i]];
+        sorted &= prev < pos || (prev == pos && rows[i - 1] < rows[i]);
+    }
+    CHECK(sorted);
+    ArrayFree(rows);
+    StoreFree(&store);
+
+    struct Allocator outOfMemory = { outOfMemoryAllocFunc, 0 };
+    CHECK(!StoreInit(&store, outOfMemory));
+
+    return failures;
+}
+
+// Pool-backed stats charge slab objects at their class size with no header
+int checkPoolStats() {
+    int failures = 0;
+
+    struct SlabCache slabs;
+    u64 slabBytes = MB(4);
+    void *memory = malloc(slabBytes);
+    SlabCacheInit(&slabs, memory, slabBytes);
+    struct Pool pool;
+    PoolInit(&pool, &slabs, DefaultHeapAllocator());
+
+    static struct AllocStats stats;
+    AllocStatsInitPool(&stats, "check", &pool);
+    struct Allocator tracked = TrackAllocator(&stats);
+
+    void *small = Alloc(tracked, 16);
+    CHECK(SlabCacheOwns(&slabs, small) && PoolSlabOf(small)->objectSize == 16);
+    CHECK(stats.live == 16);
+
+    void *largest = Alloc(tracked, POOL_MAX_SIZE);
+    CHECK(SlabCacheOwns(&slabs, largest) && PoolSlabOf(largest)->objectSize == POOL_MAX_SIZE);
+    CHECK(stats.live == 16 + POOL_MAX_SIZE);
+
+    void *big = Alloc(tracked, POOL_MAX_SIZE + 1);
+    CHECK(!SlabCacheOwns(&slabs, big));
+    CHECK(stats.live == 16 + 2 * POOL_MAX_SIZE + 1);
+
+    void *odd = Alloc(tracked, 20);
+    CHECK(stats.live == 16 + 2 * POOL_MAX_SIZE + 1 + 32);
+    memset(odd, 7, 20);
+    odd = Resize(tracked, odd, 20, 30);
+    CHECK(stats.live == 16 + 2 * POOL_MAX_SIZE + 1 + 32);
+    odd = Resize(tracked, odd, 30, 100);
+    CHECK(((u8 *)odd)[19] == 7 && PoolSlabOf(odd)->objectSize == 128);
+    CHECK(stats.live == 16 + 2 * POOL_MAX_SIZE + 1 + 128);
+
+    Free(tracked, small);
+    Free(tracked, largest);
+    Free(tracked, big);
+    Free(tracked, odd);
+    CHECK(stats.live == 0 && stats.allocs == 4 && stats.frees == 4 && stats.resizes == 2);
+
+    free(memory);
+    return failures;
+}
+
+int checkArrayOps(struct Allocator a) {
+    int failures = 0;
+
+    Array(u32) values;
+    ArrayInit(values, a);
+    for (u32 i = 0; i < 1000; i += 1)
+        ArrayPush(values, i);
+    CHECK(ArrayLen(values) == 1000 && ArrayCap(values) >= 1000);
+
+    u32 more[5] = { 1, 2, 3, 4, 5 };
+    ArrayPushN(values, more, 5);
+    ArrayInsert(values, 0, 77u);
+    CHECK(ArrayLen(values) == 1006 && values[0] == 77 && values[1] == 0 && values[1000] == 999 && ArrayLast(values) == 5);
+
+    // The last element fills the hole, everything else stays put
+    ArrayRemoveSwap(values, 0);
+    CHECK(ArrayLen(values) == 1005 && values[0] == 5 && values[1] == 0 && values[1000] == 999 && ArrayLast(values) == 4);
+
+    ArrayShrink(values);
+    CHECK(ArrayCap(values) == 1005 && values[1000] == 999);
+
+    ArrayReserve(values, 4000);
+    CHECK(ArrayCap(values) >= 4000 && ArrayLen(values) == 1005 && values[1000] == 999);
+
+    ArrayPush(values, 9u);
+    CHECK(ArrayLast(values) == 9);
+    ArrayFree(values);
+    CHECK(values == NULL);
+
+    // Stays inline until it outgrows the storage
+    ArraySmall(u32, 4) storage;
+    Array(u32) small;
+    ArrayInitSmall(small, storage, a);
+    for (u32 i = 0; i < 4; i += 1)
+        ArrayPush(small, i);
+    CHECK(small == storage.items && ArrayCap(small) == 4);
+    for (u32 i = 4; i < 100; i += 1)
+        ArrayPush(small, i);
+    CHECK(small != storage.items && ArrayLen(small) == 100 && small[3] == 3 && small[99] == 99);
+    CHECK(!(ARRAY_HEADER(small)->flags & ARRAY_INLINE));
+    ArrayFree(small);
+
+    // Shrinking or freeing inline storage leaves it alone
+    ArrayInitSmall(small, storage, a);
+    ArrayPush(small, 1u);
+    ArrayShrink(small);
+    CHECK(small == storage.items && ArrayCap(small) == 4);
+    ArrayFree(small);
+
+    return failures;
+}
+
+// Overwrites `size` bytes at `offset` in the file at `path`
+b32 patchFile(const char *path, u64 offset, const void *bytes, u64 size) {
+    FILE *file = fopen(path, "r+b");
+    if (!file)
+        return false;
+    b32 written = fseek(file, (long)offset, SEEK_SET) == 0 && fwrite(bytes, 1, size, file) == size;
+    return fclose(file) == 0 && written;
+}
+
+// A snapshot whose strings or sections point outside where they should is
+// refused at open, even without the checksum
+int checkSnapshots() {
+    int failures = 0;
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/trello-checks.snap", P_tmpdir);
+
+    struct Board boards[2] = {0};
+    boards[0].name = StrMake("first", 5, 0);
+    boards[1].name = StrMake("second", 6, 0);
+    struct SnapshotModels models = {0};
+    models.BoardItems = boards;
+    models.BoardCount = 2;
+
+    struct SnapshotHeader header;
+    SnapshotLayout(&header, &models);
+    u64 name = header.models[SnapshotModel_Board].offset + sizeof(struct BoardRecord) + offsetof(struct BoardRecord, name);
+    u64 section = offsetof(struct SnapshotHeader, models) + SnapshotModel_Board * sizeof(struct SnapshotSection);
+
+    struct Snapshot snapshot;
+    CHECK(SnapshotWrite(path, &models) == 0);
+    CHECK(SnapshotOpen(path, false, &snapshot) == 0);
+    CHECK(snapshot.BoardCount == 2 && StrEqC(SnapshotStr(&snapshot, snapshot.BoardRecords[1].name), "second"));
+    SnapshotClose(&snapshot);
+
+    struct RelStr outside = { 8, 6, 0 };
+    CHECK(patchFile(path, name, &outside, sizeof(outside)));
+    CHECK(SnapshotOpen(path, false, &snapshot) == -3);
+
+    struct RelStr escaped = { 5, 6, 1 };
+    CHECK(patchFile(path, name, &escaped, sizeof(escaped)));
+    CHECK(SnapshotOpen(path, false, &snapshot) == -3);
+
+    // Records overlapping the header
+    CHECK(SnapshotWrite(path, &models) == 0);
+    u64 insideHeader = 0;
+    CHECK(patchFile(path, section, &insideHeader, sizeof(insideHeader)));
+    CHECK(SnapshotOpen(path, false, &snapshot) == -3);
+
+    remove(path);
+    return failures;
+}
+
+// A cached tape whose links or offsets leave the tape or the JSON is
+// refused at open, even without the checksum
+int checkTapeCache() {
+    int failures = 0;
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/trello-checks.tape", P_tmpdir);
+
+    struct Allocator heap = DefaultHeapAllocator();
+    const char *json = "[{\"name\": \"first\"}, {\"name\": \"second\"}]";
+    u64 len = strlen(json);
+    uint64_t indices[64];
+    jsmn_tape tape;
+    int count = jsmn_tape_build(json, len, indices, jsmn_index64(json, len, indices), heap, &tape);
+    CHECK(count == 10 && jsmn_tape_check(&tape, len) == 0);
+
+    struct TapeCacheHeader header;
+    TapeCacheLayout(&header, len, tape.count, tape.wide_count);
+    struct TapeCache cache;
+
+    // Entry 1 holds the root's next link, entry 3 the first object's,
+    // entry 5 is the string "first"
+    struct { u64 offset; jsmntape_t entry; } corrupt[] = {
+        { 1, { (u32)len, 11 } },
+        { 3, { 18, 8 } },
+        { 5, { (u32)len - 2, JSMN_STRING | (5 << JSMN_TAPE_PAYLOAD_SHIFT) } },
+        { 5, { 0, JSMN_STRING | JSMN_TAPE_WIDE } },
+        { 5, { 9, 0 } },
+    };
+    for (u32 i = 0; i < ArrayCount(corrupt); i += 1) {
+        CHECK(TapeCacheWrite(path, json, len, &tape) == 0);
+        CHECK(TapeCacheOpen(path, false, &cache) == 0);
+        TapeCacheClose(&cache);
+        u64 at = header.entriesOffset + corrupt[i].offset * sizeof(jsmntape_t);
+        CHECK(patchFile(path, at, &corrupt[i].entry, sizeof(jsmntape_t)));
+        CHECK(TapeCacheOpen(path, false, &cache) == -3);
+    }
+
+    jsmn_tape_free(&tape, heap);
+    remove(path);
+    return failures;
+}
+
+int checkArrays() {
+    int failures = 0;
+
+    failures += checkArrayOps(DefaultHeapAllocator());
+
+    struct Arena *arena = ArenaCreate(MB(64));
+    failures += checkArrayOps(ArenaAllocator(arena));
+    ArenaDestroy(arena);
+
+    // StoreCardsInList fills an Array, small storage first
+    struct Store store;
+    StoreInit(&store, DefaultHeapAllocator());
+    struct Board board = {0};
+    board.id.bytes[0] = 1;
+    struct List lists[2] = {0};
+    lists[0].id.bytes[0] = 2;
+    lists[1].id.bytes[0] = 3;
+    lists[0].idBoard = lists[1].idBoard = board.id;
+    StoreAddBoard(&store, &board);
+    u32 firstList = StoreAddList(&store, &lists[0]);
+    u32 secondList = StoreAddList(&store, &lists[1]);
+
+    static const f64 positions[] = { 5, 1, 3, 2, 4, 0.5, 6, 7 };
+    for (u32 i = 0; i < ArrayCount(positions); i += 1) {
+        struct Card card = {0};
+        card.id.bytes[0] = 4;
+        card.id.bytes[1] = (u8)i;
+        card.idBoard = board.id;
+        card.idList = lists[i == 2].id;
+        card.pos = positions[i];
+        card.closed = i == 7;
+        StoreAddCard(&store, &card);
+    }
+
+    ArraySmall(u32, 2) storage;
+    Array(u32) rows;
+    ArrayInitSmall(rows, storage, DefaultHeapAllocator());
+    u32 count = StoreCardsInList(&store, firstList, &rows);
+    CHECK(count == 6 && ArrayLen(rows) == 6);
+    for (u32 i = 1; i < count; i += 1)
+        CHECK(store.cards.pos[rows[i - 1]] <= store.cards.pos[rows[i]]);
+    CHECK(rows[0] == 5 && rows[5] == 6);
 
-    jsmntok_t *tokens = calloc(tokenCount, sizeof(jsmntok_t));
-    if (!tokens) {
-        return -4;
+    count = StoreCardsInList(&store, secondList, &rows);
+    CHECK(count == 1 && rows[0] == 2);
+    ArrayFree(rows);
+    StoreFree(&store);
+
+    // A grow that runs out of memory keeps what was there and drops the push
+    struct Allocator outOfMemory = { outOfMemoryAllocFunc, 0 };
+    ArraySmall(u32, 4) small;
+    Array(u32) values;
+    ArrayInitSmall(values, small, outOfMemory);
+    for (u32 i = 0; i < 6; i += 1)
+        ArrayPush(values, i);
+    u32 more[2] = { 6, 7 };
+    ArrayPushN(values, more, 2);
+    ArrayInsert(values, 0, 8);
+    CHECK(ArrayFailed(values) && ArrayLen(values) == 4 && ArrayCap(values) == 4);
+    CHECK(values == small.items && values[0] == 0 && values[3] == 3);
+    ArrayFree(values);
+
+    return failures;
+}
+
+// A board whose name sits 5GB into the document, built into a tape by
+// jsmn_index64 and jsmn_tape_build, so it needs wide tape records and
+// offsets that don't fit an int. jsmn_index refuses a document that long.
+int checkWideTape() {
+    int failures = 0;
+
+#if defined(PLATFORM_POSIX)
+    // A 5GB document of whitespace without 5GB of memory: one page of
+    // spaces from a temporary file is mapped over and over in between the
+    // first and last pages, which hold the actual JSON
+    u64 page = MB(1);
+    u64 far = GB(5);
+    u64 reserved = far + page;
+    char *json = VMReserve(NULL, reserved, 0);
+    FILE *spaces = tmpfile();
+    b32 mapped = json && spaces && VMCommit(json, page) && VMCommit(json + far, page);
+    if (mapped) {
+        char *blank = malloc(page);
+        memset(blank, ' ', page);
+        mapped = fwrite(blank, 1, page, spaces) == page && fflush(spaces) == 0;
+        free(blank);
+    }
+    for (u64 at = page; mapped && at < far; at += page)
+        mapped = mmap(json + at, page, PROT_READ, MAP_SHARED | MAP_FIXED, fileno(spaces), 0) != MAP_FAILED;
+    if (!mapped) {
+        printf("Couldn't map a 5GB document, skipping the wide tape check\n");
+        if (spaces) fclose(spaces);
+        if (json) VMRelease(json, reserved);
+        return 0;
     }
+    memset(json, ' ', page);
+    memset(json + far, ' ', page);
+    memcpy(json, "{\"name\":", 8);
+    memcpy(json + far, "\"hello\"}", 8);
+    u64 len = far + 8;
 
+    uint64_t indices[16];
+    int indexCount = jsmn_index64(json, len, indices);
+    CHECK(indexCount == 7 && indices[4] == far);
+    CHECK(jsmn_index(json, len, (unsigned int *)indices) == JSMN_ERROR_INVAL);
+
+    struct Allocator heap = DefaultHeapAllocator();
+    jsmn_tape tape;
+    CHECK(jsmn_tape_build(json, len, indices, indexCount, heap, &tape) == 4);
+    CHECK(tape.wide_count == 2 && jsmn_tape_end(&tape, 0) == len);
+    CHECK(jsmn_tape_start(&tape, 3) == far + 1 && jsmn_tape_end(&tape, 3) == far + 6);
+
+    struct Board board = {0};
+    unsigned int index = 0;
+    CHECK(DecodeBoardTape(json, &tape, &index, &board) == 0);
+    CHECK(index == 4 && StrEqC(board.name, "hello") && board.name.data == json + far + 1);
+
+    jsmn_tape_free(&tape, heap);
+    fclose(spaces);
+    VMRelease(json, reserved);
+#endif
+    return failures;
+}
+
+// The heap, except that it refuses to shrink anything
+ALLOC_FUNC(noShrinkAllocFunc) {
+    if (type == AT_Resize && old && size < oldSize)
+        return NULL;
+    return defaultHeapAllocFunc(payload, type, size, oldSize, old);
+}
+
+// A failed trim at the end of jsmn_parse_alloc keeps the untrimmed tokens,
+// and a failed trim in jsmn_tape_build keeps the untrimmed tape
+int checkParseAlloc() {
+    int failures = 0;
+
+    struct Allocator noShrink = { noShrinkAllocFunc, 0 };
+    const char *json = "[{\"a\": 1}, {\"b\": [true, false]}, \"c\"]";
+    jsmn_parser parser;
     jsmn_init(&parser);
+    jsmntok_t *tokens = NULL;
+    int count = jsmn_parse_alloc(&parser, json, strlen(json), noShrink, &tokens);
+    CHECK(count == 10 && tokens != NULL);
+    if (tokens) {
+        CHECK(tokens[0].type == JSMN_ARRAY && tokens[0].size == 3);
+        CHECK(tokens[count - 1].type == JSMN_STRING && json[tokens[count - 1].start] == 'c');
+        Free(noShrink, tokens);
+    }
+
+    // Same for the final trim of jsmn_tape_build
+    uint64_t indices[64];
+    int indexCount = jsmn_index64(json, strlen(json), indices);
+    jsmn_tape tape;
+    count = jsmn_tape_build(json, strlen(json), indices, indexCount, noShrink, &tape);
+    CHECK(count == 14 && tape.entries != NULL);
+    if (tape.entries) {
+        CHECK(jsmn_tape_type(&tape, 0) == JSMN_ARRAY && jsmn_tape_size(&tape, 0) == 3);
+        CHECK(jsmn_tape_next(&tape, 0) == (unsigned int)count);
+        CHECK(jsmn_tape_type(&tape, count - 1) == JSMN_STRING && json[jsmn_tape_start(&tape, count - 1)] == 'c');
+        jsmn_tape_free(&tape, noShrink);
+    }
+
+    return failures;
+}
+
+int runChecks() {
+    int failures = 0;
+    failures += checkDecodeEdges();
+    failures += checkStrs();
+    failures += checkStoreRefs();
+    failures += checkTapeCache();
+    failures += checkSnapshots();
+    failures += checkParseAlloc();
+    failures += checkWideTape();
+    failures += checkArrays();
+    failures += checkPoolStats();
+    failures += checkStoreLabels();
+    failures += checkSchemas();
+    failures += checkTables();
+    failures += checkRelPtrs();
+    printf("%s, %d failed\n", failures ? "Checks FAILED" : "Checks passed", failures);
+    return failures ? 1 : 0;
+}
+
+// Parses and prints through tagged allocators, then reports what each one
+// saw
+int trackedBoards(const char *json) {
+    static struct AllocStats jsonStats, frameStats;
+    AllocStatsInit(&jsonStats, "json", DefaultHeapAllocator());
+
+    struct Arena scratch;
+    ArenaInit(&scratch, malloc(MB(16)), MB(16));
+    AllocStatsInit(&frameStats, "frame", ArenaAllocator(&scratch));
+
+    struct Allocator tracked = TrackAllocator(&jsonStats);
+    struct Allocator frame = TrackAllocator(&frameStats);
+
+    struct Board *boards;
+    int boardCount = parseBoards(json, tracked, &boards);
+    if (boardCount < 0) {
+        printf("Failed to parse response (%d)\n", boardCount);
+        return 1;
+    }
+
+    printf("Parsed %d boards:\n", boardCount);
+    for (int i = 0; i < boardCount; i += 1)
+        printBoard(frame, &boards[i]);
+    Free(tracked, boards);
+
+    printf("\n");
+    AllocStatsWrite(stdout);
+
+    FreeAll(frame);
+    free(scratch.base);
+    return 0;
+}
+
+// What a parse worker leaves at the start of the arena it hands off
+struct ParsedBoards {
+    struct Board *boards;
     int count;
-    count = jsmn_parse(&parser, json, strlen(json), tokens, tokenCount);
-    if (count < 0) {
-        printf("Failed to load tokens: %d\n", count);
-        return -5;
+};
+
+struct ParseJob {
+    const char *json;
+    struct Handoff *queue;
+};
+
+void *parseBoardsWorker(void *payload) {
+    struct ParseJob *job = payload;
+    struct Arena *arena = ArenaCreate(MB(16));
+    if (!arena)
+        return NULL;
+
+    struct Allocator a = ArenaAllocator(arena);
+    struct ParsedBoards *parsed = Alloc(a, sizeof(struct ParsedBoards));
+    parsed->count = parseBoards(job->json, a, &parsed->boards);
+    HandoffPush(job->queue, arena);
+    return NULL;
+}
+
+// Parses on a worker thread and prints the boards from the arena it hands
+// back, without copying them out
+int handoffBoards(const char *json) {
+    struct Handoff queue = {0};
+    struct ParseJob job = { json, &queue };
+
+    pthread_t worker;
+    pthread_create(&worker, NULL, parseBoardsWorker, &job);
+    pthread_join(worker, NULL);
+
+    struct Arena *arena = HandoffPop(&queue);
+    if (!arena) {
+        printf("Worker didn't hand anything back\n");
+        return 1;
     }
 
-    if (tokens[0].type != JSMN_ARRAY) {
-        printf("json type: %d\n", tokens[0].type);
-        return -1;
+    struct ParsedBoards *parsed = (struct ParsedBoards *)arena->base;
+    if (parsed->count < 0) {
+        printf("Failed to parse response (%d)\n", parsed->count);
+        ArenaDestroy(arena);
+        return 1;
     }
 
-    int boardCount = tokens[0].size;
+    printf("Parsed %d boards:\n", parsed->count);
+    for (int i = 0; i < parsed->count; i += 1)
+        printBoard(ArenaAllocator(arena), &parsed->boards[i]);
 
-    // TODO(Brett): don't malloc, use allocator instead
-    struct Board *boards = calloc(boardCount, sizeof(struct Board));
-    
-    int offset = 1;
-    for (size_t boardIndex = 0; boardIndex < boardCount; boardIndex++) {
-        struct Board *board = boards+boardIndex;
-        jsmntok_t obj = tokens[offset++];
+    ArenaDestroy(arena);
+    return 0;
+}
 
-        if (obj.type != JSMN_OBJECT) {
-            // TODO(Brett): error label and cleanup allocations
-            return -2;
+u64 benchRandom(u64 *state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1Dull;
+}
+
+// ns per operation for `count` ops that took `us`
+f64 nsPerOp(unsigned long us, u64 count) {
+    return count ? us * 1000.0 / count : 0;
+}
+
+// Inserts, hits and misses for U32Map against TABLE and SwissMap at growing
+// key counts. U32Map can't grow, so it gets twice the keys up front. The
+// others' inserts are timed both reserved up front and grown from empty.
+int benchMaps() {
+    static const u64 sizes[] = { 1000, 10000, 100000, 1000000, 10000000 };
+    struct Allocator heap = DefaultHeapAllocator();
+
+    printf("%10s %-8s %12s %12s %12s %12s\n", "keys", "map", "insert ns", "grown ns", "hit ns", "miss ns");
+    for (size_t s = 0; s < ArrayCount(sizes); s += 1) {
+        u64 count = sizes[s];
+        u64 reps = count < 1000000 ? 1000000 / count : 1;
+        u64 *keys = malloc(sizeof(u64) * count * 2);
+        u64 state = 0x9E3779B97F4A7C15ull;
+        for (u64 i = 0; i < count * 2; i += 1)
+            keys[i] = benchRandom(&state) | 1;
+        u64 *misses = keys + count;
+
+        usTimer timer;
+        u64 sum = 0;
+
+        struct U32Map map;
+        usTimerInit(&timer);
+        for (u64 r = 0; r < reps; r += 1) {
+            if (r) { Free(heap, map.keys); Free(heap, map.values); }
+            U32MapInit(&map, heap, count * 2);
+            for (u64 i = 0; i < count; i += 1)
+                U32MapSet(&map, keys[i], (u32)i);
         }
+        unsigned long insertUs = GetTimeus(&timer);
 
-        int fields = obj.size;
+        usTimerInit(&timer);
+        for (u64 r = 0; r < reps; r += 1)
+            for (u64 i = 0; i < count; i += 1)
+                sum += *U32MapGet(&map, keys[i]);
+        unsigned long hitUs = GetTimeus(&timer);
 
-        for (size_t i = 0; i < fields; i += 1) {
-            jsmntok_t field = tokens[offset++];
+        usTimerInit(&timer);
+        for (u64 r = 0; r < reps; r += 1)
+            for (u64 i = 0; i < count; i += 1)
+                sum += U32MapGet(&map, misses[i]) != NULL;
+        unsigned long missUs = GetTimeus(&timer);
 
-            extractString("name", field, &tokens[offset], json, &board->name);
-            extractString("id", field, &tokens[offset], json, &board->id);
-            extractString("shortUrl", field, &tokens[offset], json, &board->shortUrl);
+        printf("%10llu %-8s %12.1f %12s %12.1f %12.1f\n", (unsigned long long)count, "U32Map",
+            nsPerOp(insertUs, count * reps), "-", nsPerOp(hitUs, count * reps), nsPerOp(missUs, count * reps));
+        Free(heap, map.keys);
+        Free(heap, map.values);
 
-            skipTokens(tokens, &offset);
+        struct U32Table table;
+        usTimerInit(&timer);
+        for (u64 r = 0; r < reps; r += 1) {
+            if (r) U32TableFree(&table);
+            U32TableInit(&table, heap);
+            for (u64 i = 0; i < count; i += 1)
+                U32TableSet(&table, keys[i], (u32)i);
         }
+        unsigned long grownUs = GetTimeus(&timer);
+
+        usTimerInit(&timer);
+        for (u64 r = 0; r < reps; r += 1) {
+            U32TableFree(&table);
+            U32TableInitReserve(&table, heap, count);
+            for (u64 i = 0; i < count; i += 1)
+                U32TableSet(&table, keys[i], (u32)i);
+        }
+        insertUs = GetTimeus(&timer);
+
+        usTimerInit(&timer);
+        for (u64 r = 0; r < reps; r += 1)
+            for (u64 i = 0; i < count; i += 1)
+                sum += *U32TableGet(&table, keys[i]);
+        hitUs = GetTimeus(&timer);
+
+        usTimerInit(&timer);
+        for (u64 r = 0; r < reps; r += 1)
+            for (u64 i = 0; i < count; i += 1)
+                sum += U32TableGet(&table, misses[i]) != NULL;
+        missUs = GetTimeus(&timer);
+
+        printf("%10llu %-8s %12.1f %12.1f %12.1f %12.1f\n", (unsigned long long)count, "TABLE",
+            nsPerOp(insertUs, count * reps), nsPerOp(grownUs, count * reps),
+            nsPerOp(hitUs, count * reps), nsPerOp(missUs, count * reps));
+
+        // Remove every other key and check both halves
+        u64 wrong = 0;
+        for (u64 i = 0; i < count; i += 2)
+            wrong += !U32TableRemove(&table, keys[i]);
+        for (u64 i = 0; i < count; i += 1) {
+            u32 *value = U32TableGet(&table, keys[i]);
+            wrong += (i & 1) ? (!value || *value != (u32)i) : value != NULL;
+        }
+        if (wrong || table.len != count / 2)
+            printf("TABLE lost %llu keys after removes\n", (unsigned long long)wrong);
+
+        U32TableFree(&table);
+
+        struct SwissMap swiss;
+        usTimerInit(&timer);
+        for (u64 r = 0; r < reps; r += 1) {
+            if (r) SwissMapFree(&swiss);
+            SwissMapInit(&swiss, heap, 0);
+            for (u64 i = 0; i < count; i += 1)
+                SwissMapSet(&swiss, keys[i], (u32)i);
+        }
+        grownUs = GetTimeus(&timer);
+
+        usTimerInit(&timer);
+        for (u64 r = 0; r < reps; r += 1) {
+            SwissMapFree(&swiss);
+            SwissMapInit(&swiss, heap, count);
+            for (u64 i = 0; i < count; i += 1)
+                SwissMapSet(&swiss, keys[i], (u32)i);
+        }
+        insertUs = GetTimeus(&timer);
+
+        usTimerInit(&timer);
+        for (u64 r = 0; r < reps; r += 1)
+            for (u64 i = 0; i < count; i += 1)
+                sum += *SwissMapGet(&swiss, keys[i]);
+        hitUs = GetTimeus(&timer);
+
+        usTimerInit(&timer);
+        for (u64 r = 0; r < reps; r += 1)
+            for (u64 i = 0; i < count; i += 1)
+                sum += SwissMapGet(&swiss, misses[i]) != NULL;
+        missUs = GetTimeus(&timer);
+
+        printf("%10llu %-8s %12.1f %12.1f %12.1f %12.1f\n", (unsigned long long)count, "Swiss",
+            nsPerOp(insertUs, count * reps), nsPerOp(grownUs, count * reps),
+            nsPerOp(hitUs, count * reps), nsPerOp(missUs, count * reps));
+
+        wrong = 0;
+        for (u64 i = 0; i < count; i += 2)
+            SwissMapRemove(&swiss, keys[i]);
+        for (u64 i = 0; i < count; i += 1) {
+            u32 *value = SwissMapGet(&swiss, keys[i]);
+            wrong += (i & 1) ? (!value || *value != (u32)i) : value != NULL;
+        }
+        if (wrong || swiss.len != count / 2)
+            printf("Swiss lost %llu keys after removes\n", (unsigned long long)wrong);
+
+        SwissMapFree(&swiss);
+        free(keys);
+        if (sum == 42) printf(" ");
     }
 
-    *boardsOut = boards;
-    return boardCount;
+    return 0;
+}
+
+// fnv64a against HashBytes on short keys, hex IDs and long descriptions
+int benchHashes() {
+    static const u32 lengths[] = { 8, 24, 4096 };
+    static const char *names[] = { "8 byte key", "24 byte hex id", "4KB desc" };
+
+    u8 *data = malloc(MB(1) + 4096);
+    u64 state = 0x9E3779B97F4A7C15ull;
+    for (u32 i = 0; i < MB(1) + 4096; i += 1)
+        data[i] = (u8)benchRandom(&state);
+
+    u64 sum = 0;
+    usTimer timer;
+    printf("%-16s %10s %10s %10s %10s\n", "input", "fnv64a ns", "GB/s", "Hash ns", "GB/s");
+    for (size_t l = 0; l < ArrayCount(lengths); l += 1) {
+        u32 len = lengths[l];
+        u64 count = MB(64) / len;
+        u64 offsetMask = MB(1) - 1;
+
+        usTimerInit(&timer);
+        for (u64 i = 0; i < count; i += 1)
+            sum += fnv64a(data + ((i * 64) & offsetMask), len);
+        unsigned long fnvUs = GetTimeus(&timer);
+
+        usTimerInit(&timer);
+        for (u64 i = 0; i < count; i += 1)
+            sum += HashBytes(data + ((i * 64) & offsetMask), len, 0);
+        unsigned long hashUs = GetTimeus(&timer);
+
+        printf("%-16s %10.1f %10.2f %10.1f %10.2f\n", names[l],
+            nsPerOp(fnvUs, count), (f64)count * len / (fnvUs * 1000.0),
+            nsPerOp(hashUs, count), (f64)count * len / (hashUs * 1000.0));
+    }
+
+    u64 count = MB(64) / 12;
+    usTimerInit(&timer);
+    for (u64 i = 0; i < count; i += 1)
+        sum += HashId96(data + ((i * 16) & (MB(1) - 1)));
+    unsigned long idUs = GetTimeus(&timer);
+    printf("%-16s %10s %10s %10.1f %10.2f\n", "12 byte id", "-", "-",
+        nsPerOp(idUs, count), (f64)count * 12 / (idUs * 1000.0));
+
+    free(data);
+    if (sum == 42) printf(" ");
+    return 0;
+}
+
+// Simulates sync churn: a working set of model objects where every step
+// frees a random one and allocates another in its place
+unsigned long benchChurn(struct Allocator a, void **live, u64 liveCount, u64 steps) {
+    static const u64 sizes[] = { sizeof(struct Board), sizeof(struct List), sizeof(struct Card), sizeof(struct Label), sizeof(struct Member) };
+    u64 state = 0x9E3779B97F4A7C15ull;
+
+    usTimer timer;
+    usTimerInit(&timer);
+    for (u64 i = 0; i < liveCount; i += 1)
+        live[i] = Alloc(a, sizes[i % ArrayCount(sizes)]);
+
+    for (u64 i = 0; i < steps; i += 1) {
+        u64 r = benchRandom(&state);
+        u64 slot = r % liveCount;
+        Free(a, live[slot]);
+        live[slot] = Alloc(a, sizes[(r >> 32) % ArrayCount(sizes)]);
+        memset(live[slot], 0, 16);
+    }
+    return GetTimeus(&timer);
+}
+
+// Objects allocated on one thread and freed on another, so every free goes
+// through the owner's remote list
+#define REMOTE_RING_SIZE 1024
+
+struct RemoteRing {
+    void *slots[REMOTE_RING_SIZE];
+    u64 head __attribute__((aligned(64))); // written by the allocating thread
+    u64 tail __attribute__((aligned(64))); // written by the freeing thread
+    u64 count;
+};
+
+void *remoteFreeWorker(void *payload) {
+    struct RemoteRing *ring = payload;
+    struct Allocator thread = ThreadAllocator();
+    for (u64 freed = 0; freed < ring->count; freed += 1) {
+        while (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == ring->tail)
+            sched_yield();
+        Free(thread, ring->slots[ring->tail % REMOTE_RING_SIZE]);
+        __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+// Objects handed out by the pool and not freed yet
+u64 poolLiveObjects(struct Pool *pool) {
+    u64 live = 0;
+    for (u32 c = 0; c < POOL_CLASS_COUNT; c += 1) {
+        for (struct PoolSlab *slab = pool->classes[c].partial; slab; slab = slab->next)
+            live += slab->used;
+        for (struct PoolSlab *slab = pool->classes[c].full; slab; slab = slab->next)
+            live += slab->used;
+    }
+    return live;
+}
+
+void benchRemoteFree(u64 count) {
+    static const u64 sizes[] = { sizeof(struct Board), sizeof(struct List), sizeof(struct Card), sizeof(struct Label), sizeof(struct Member) };
+    struct Allocator thread = ThreadAllocator();
+    struct ThreadHeap *heap = ThreadHeapGet();
+    u64 liveBefore = poolLiveObjects(&heap->pool);
+
+    static struct RemoteRing ring;
+    ring.head = ring.tail = 0;
+    ring.count = count;
+
+    usTimer timer;
+    usTimerInit(&timer);
+    pthread_t worker;
+    pthread_create(&worker, NULL, remoteFreeWorker, &ring);
+    for (u64 i = 0; i < count; i += 1) {
+        while (ring.head - __atomic_load_n(&ring.tail, __ATOMIC_ACQUIRE) == REMOTE_RING_SIZE)
+            sched_yield();
+        void *object = Alloc(thread, sizes[i % ArrayCount(sizes)]);
+        memset(object, 0, 16);
+        ring.slots[ring.head % REMOTE_RING_SIZE] = object;
+        __atomic_store_n(&ring.head, ring.head + 1, __ATOMIC_RELEASE);
+    }
+    pthread_join(worker, NULL);
+    ThreadHeapDrain(heap);
+    unsigned long us = GetTimeus(&timer);
+
+    u64 leaked = poolLiveObjects(&heap->pool) - liveBefore;
+    printf("%10llu allocated here, freed on another thread: %.1f ns per object, %s\n",
+        (unsigned long long)count, nsPerOp(us, count), leaked ? "objects LEAKED" : "all returned");
+}
+
+int benchPools() {
+    static const u64 counts[] = { 1000, 100000, 1000000 };
+    u64 steps = 10000000;
+    struct Allocator heap = DefaultHeapAllocator();
+
+    struct SlabCache slabs;
+    u64 slabBytes = MB(256);
+    void *slabMemory = mmap(NULL, slabBytes, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (slabMemory == MAP_FAILED)
+        return 1;
+    SlabCacheInit(&slabs, slabMemory, slabBytes);
+
+    printf("%10s %12s %12s %12s %12s\n", "live", "malloc ns", "pool ns", "thread ns", "close us");
+    for (size_t c = 0; c < ArrayCount(counts); c += 1) {
+        u64 count = counts[c];
+        void **live = malloc(sizeof(void *) * count);
+
+        // Second runs are timed, so both start with their memory faulted in
+        unsigned long heapUs = 0;
+        for (u32 run = 0; run < 2; run += 1) {
+            heapUs = benchChurn(heap, live, count, steps);
+            for (u64 i = 0; i < count; i += 1)
+                Free(heap, live[i]);
+        }
+
+        struct Pool pool;
+        PoolInit(&pool, &slabs, heap);
+        unsigned long poolUs = benchChurn(PoolAllocator(&pool), live, count, steps);
+        FreeAll(PoolAllocator(&pool));
+        poolUs = benchChurn(PoolAllocator(&pool), live, count, steps);
+
+#ifdef DIAGNOSTICS
+        if (c == 0)
+            PoolPrintStats(&pool);
+#endif
+
+        // Closing a board drops all of its objects at once
+        usTimer timer;
+        usTimerInit(&timer);
+        FreeAll(PoolAllocator(&pool));
+        unsigned long closeUs = GetTimeus(&timer);
+
+        // Same again through this thread's heap
+        struct Allocator thread = ThreadAllocator();
+        unsigned long threadUs = 0;
+        for (u32 run = 0; run < 2; run += 1) {
+            threadUs = benchChurn(thread, live, count, steps);
+            for (u64 i = 0; i < count; i += 1)
+                Free(thread, live[i]);
+        }
+
+        printf("%10llu %12.1f %12.1f %12.1f %12lu\n", (unsigned long long)count,
+            nsPerOp(heapUs, count + steps), nsPerOp(poolUs, count + steps), nsPerOp(threadUs, count + steps), closeUs);
+        free(live);
+    }
+
+    printf("%u slabs mapped, %u free\n", slabs.slabCount, slabs.freeCount);
+    munmap(slabMemory, slabBytes);
+
+    benchRemoteFree(steps);
+    return 0;
 }
 
 int main(int argc, char **argv) {
     if (argc < 2) {
-        printf("Usage: %s <json>\n", argv[0]);
+        printf("Usage: %s [--bench | --stream | --parallel | --ondemand | --cache | --convert | --verify | --store | --handoff | --telemetry | --maps | --hashes | --pools | --checks] <json>\n", argv[0]);
+        return 1;
     }
 
-    FILE *file = fopen(argv[1], "r");
+    if (strcmp(argv[1], "--maps") == 0) {
+        return benchMaps();
+    }
+
+    if (strcmp(argv[1], "--hashes") == 0) {
+        return benchHashes();
+    }
+
+    if (strcmp(argv[1], "--pools") == 0) {
+        return benchPools();
+    }
+
+    if (strcmp(argv[1], "--checks") == 0) {
+        return runChecks();
+    }
+
+    b32 benchMode = strcmp(argv[1], "--bench") == 0;
+    b32 streamMode = strcmp(argv[1], "--stream") == 0;
+    b32 parallelMode = strcmp(argv[1], "--parallel") == 0;
+    b32 onDemandMode = strcmp(argv[1], "--ondemand") == 0;
+    b32 cacheMode = strcmp(argv[1], "--cache") == 0;
+    b32 convertMode = strcmp(argv[1], "--convert") == 0;
+    b32 verifyMode = strcmp(argv[1], "--verify") == 0;
+    b32 storeMode = strcmp(argv[1], "--store") == 0;
+    b32 handoffMode = strcmp(argv[1], "--handoff") == 0;
+    b32 telemetryMode = strcmp(argv[1], "--telemetry") == 0;
+    const char *path = argv[argc-1];
+
+    if (cacheMode) {
+        return cachedBoards(path);
+    }
+
+    FILE *file = fopen(path, "r");
     if (!file) {
         printf("Failed to open file\n");
         return 1;
     }
 
-    char *json = malloc(1024 * 1024);
+    if (streamMode) {
+        return streamBoards(file);
+    }
+
+    char *json = calloc(1, 1024 * 1024 + 1);
     int bytesRead = fread(json, 1, 1024*1024, file);
     printf("Read %d bytes: \n", bytesRead);
 
+    // NOTE(Brett): everything for this response comes out of one arena that
+    // is dropped at once when we're done with it. It's only reserved, so a
+    // bigger response just commits more of it.
+    struct Arena *scratch = ArenaCreate(GB(4));
+    if (!scratch) {
+        printf("Failed to reserve memory\n");
+        return 1;
+    }
+    struct Allocator temp = ArenaAllocator(scratch);
+
+    if (benchMode) {
+        return bench(json);
+    }
+
+    if (convertMode) {
+        return convertSnapshot(path, json);
+    }
+
+    if (verifyMode) {
+        return verifySnapshot(path, json);
+    }
+
+    if (storeMode) {
+        return storeBoards(json);
+    }
+
+    if (handoffMode) {
+        return handoffBoards(json);
+    }
+
+    if (telemetryMode) {
+        return trackedBoards(json);
+    }
+
     struct Board *boards;
-    int boardCount = parseBoards(json, &boards);
+    int boardCount;
+    if (onDemandMode)
+        boardCount = parseBoardsOnDemand(json, strlen(json), temp, &boards);
+    else if (parallelMode)
+        boardCount = DecodeArrayParallelOf(Board, json, strlen(json), threadCount(), temp, &boards);
+    else
+        boardCount = parseBoards(json, temp, &boards);
     if (boardCount < 0) {
         printf("Failed to parse response (%d)\n", boardCount);
         return 1;
@@ -167,9 +1814,12 @@ int main(int argc, char **argv) {
 
     printf("Parsed %d boards:\n", boardCount);
     for (size_t i = 0; i < boardCount; i += 1) {
-        struct Board board = boards[i];
-        printf("  id: '%s', name: '%s', shortUrl: '%s'\n", board.id, board.name, board.shortUrl);
+        struct ArenaTemp line = ArenaTempBegin(scratch);
+        printBoard(temp, &boards[i]);
+        ArenaTempEnd(line);
     }
 
+    ArenaDestroy(scratch);
+
     return 0;
 }